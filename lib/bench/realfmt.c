@@ -0,0 +1,88 @@
+/*
+	benchmark of Real formatting: the old sprintf("%.8f") based
+	 real_to_buf() against ju_format_real(). from lib/ run
+	   make bench/realfmt && ./bench/realfmt
+*/
+#include "../jupiter.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define N 1000000
+
+// lib/justd.c before ju_format_real()
+static size_t old_real_to_buf (char* buf, ju_real r)
+{
+	size_t len;
+
+	sprintf(buf, "%.8f", r);
+	len = strlen(buf);
+
+	while (buf[len - 1] == '0')
+		len--;
+	if (buf[len - 1] == '.')
+		len++;
+
+	return len;
+}
+
+static uint64_t seed = 88172645463325252ULL;
+static uint64_t next ()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+static void run (const char* name, ju_real* vals,
+                  size_t (*fmt) (char*, ju_real))
+{
+	// large enough for "%.8f" of any double
+	static char buf[512];
+	size_t i, bad = 0, total = 0;
+	clock_t start = clock();
+
+	for (i = 0; i < N; i++)
+		total += fmt(buf, vals[i]);
+
+	double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	for (i = 0; i < N; i++)
+	{
+		buf[fmt(buf, vals[i])] = '\0';
+		if (strtod(buf, NULL) != vals[i])
+			bad++;
+	}
+
+	printf("  %-8s %7.1f ns/number  %8zu bytes  %7zu don't read back\n",
+		name, secs * 1e9 / N, total, bad);
+}
+
+int main ()
+{
+	static ju_real vals[N];
+	size_t i;
+
+	// prices and measurements
+	for (i = 0; i < N; i++)
+		vals[i] = (double) (next() % 10000000) / 100.0;
+	printf("values like 12345.67\n");
+	run("old", vals, old_real_to_buf);
+	run("new", vals, ju_format_real);
+
+	// anything in a range where "%.8f" still fits
+	for (i = 0; i < N; i++)
+	{
+		uint64_t bits = next();
+		memcpy(vals + i, &bits, sizeof(bits));
+
+		if (vals[i] != vals[i] || vals[i] > 1e15 || vals[i] < -1e15)
+			i--;
+	}
+	printf("random doubles up to 1e15\n");
+	run("old", vals, old_real_to_buf);
+	run("new", vals, ju_format_real);
+
+	return 0;
+}
@@ -0,0 +1,369 @@
+#include "jupiter.h"
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	shortest decimal representation of a double that reads back as
+	 the same double, using Grisu3 (Florian Loitsch, "Printing
+	 Floating-Point Numbers Quickly and Accurately with Integers")
+
+	the double and the edges of the interval of numbers that round
+	 to it are scaled by a cached power of ten into a range where
+	 64 bit integers hold enough digits, and digits are generated
+	 until the result is inside of that interval. the scaling is off
+	 by a unit or so, which is fine for all but about 0.5% of doubles;
+	 for those Grisu3 can't be sure it has the shortest digits, and
+	 they are searched for with printf and strtod instead
+*/
+
+typedef struct
+{
+	uint64_t f;
+	int e;
+} diyfp;
+
+#define DP_SIGNIFICAND 0x000fffffffffffffULL
+#define DP_HIDDEN_BIT  0x0010000000000000ULL
+#define DP_EXP_BIAS    1075
+
+// 10^-348, 10^-340, ..., 10^340 as normalized diyfp's
+static const diyfp cached_powers[] = {
+	{ 0xfa8fd5a0081c0288ULL, -1220 }, { 0xbaaee17fa23ebf76ULL, -1193 }, { 0x8b16fb203055ac76ULL, -1166 },
+	{ 0xcf42894a5dce35eaULL, -1140 }, { 0x9a6bb0aa55653b2dULL, -1113 }, { 0xe61acf033d1a45dfULL, -1087 },
+	{ 0xab70fe17c79ac6caULL, -1060 }, { 0xff77b1fcbebcdc4fULL, -1034 }, { 0xbe5691ef416bd60cULL, -1007 },
+	{ 0x8dd01fad907ffc3cULL, -980 }, { 0xd3515c2831559a83ULL, -954 }, { 0x9d71ac8fada6c9b5ULL, -927 },
+	{ 0xea9c227723ee8bcbULL, -901 }, { 0xaecc49914078536dULL, -874 }, { 0x823c12795db6ce57ULL, -847 },
+	{ 0xc21094364dfb5637ULL, -821 }, { 0x9096ea6f3848984fULL, -794 }, { 0xd77485cb25823ac7ULL, -768 },
+	{ 0xa086cfcd97bf97f4ULL, -741 }, { 0xef340a98172aace5ULL, -715 }, { 0xb23867fb2a35b28eULL, -688 },
+	{ 0x84c8d4dfd2c63f3bULL, -661 }, { 0xc5dd44271ad3cdbaULL, -635 }, { 0x936b9fcebb25c996ULL, -608 },
+	{ 0xdbac6c247d62a584ULL, -582 }, { 0xa3ab66580d5fdaf6ULL, -555 }, { 0xf3e2f893dec3f126ULL, -529 },
+	{ 0xb5b5ada8aaff80b8ULL, -502 }, { 0x87625f056c7c4a8bULL, -475 }, { 0xc9bcff6034c13053ULL, -449 },
+	{ 0x964e858c91ba2655ULL, -422 }, { 0xdff9772470297ebdULL, -396 }, { 0xa6dfbd9fb8e5b88fULL, -369 },
+	{ 0xf8a95fcf88747d94ULL, -343 }, { 0xb94470938fa89bcfULL, -316 }, { 0x8a08f0f8bf0f156bULL, -289 },
+	{ 0xcdb02555653131b6ULL, -263 }, { 0x993fe2c6d07b7facULL, -236 }, { 0xe45c10c42a2b3b06ULL, -210 },
+	{ 0xaa242499697392d3ULL, -183 }, { 0xfd87b5f28300ca0eULL, -157 }, { 0xbce5086492111aebULL, -130 },
+	{ 0x8cbccc096f5088ccULL, -103 }, { 0xd1b71758e219652cULL, -77 }, { 0x9c40000000000000ULL, -50 },
+	{ 0xe8d4a51000000000ULL, -24 }, { 0xad78ebc5ac620000ULL, 3 }, { 0x813f3978f8940984ULL, 30 },
+	{ 0xc097ce7bc90715b3ULL, 56 }, { 0x8f7e32ce7bea5c70ULL, 83 }, { 0xd5d238a4abe98068ULL, 109 },
+	{ 0x9f4f2726179a2245ULL, 136 }, { 0xed63a231d4c4fb27ULL, 162 }, { 0xb0de65388cc8ada8ULL, 189 },
+	{ 0x83c7088e1aab65dbULL, 216 }, { 0xc45d1df942711d9aULL, 242 }, { 0x924d692ca61be758ULL, 269 },
+	{ 0xda01ee641a708deaULL, 295 }, { 0xa26da3999aef774aULL, 322 }, { 0xf209787bb47d6b85ULL, 348 },
+	{ 0xb454e4a179dd1877ULL, 375 }, { 0x865b86925b9bc5c2ULL, 402 }, { 0xc83553c5c8965d3dULL, 428 },
+	{ 0x952ab45cfa97a0b3ULL, 455 }, { 0xde469fbd99a05fe3ULL, 481 }, { 0xa59bc234db398c25ULL, 508 },
+	{ 0xf6c69a72a3989f5cULL, 534 }, { 0xb7dcbf5354e9beceULL, 561 }, { 0x88fcf317f22241e2ULL, 588 },
+	{ 0xcc20ce9bd35c78a5ULL, 614 }, { 0x98165af37b2153dfULL, 641 }, { 0xe2a0b5dc971f303aULL, 667 },
+	{ 0xa8d9d1535ce3b396ULL, 694 }, { 0xfb9b7cd9a4a7443cULL, 720 }, { 0xbb764c4ca7a44410ULL, 747 },
+	{ 0x8bab8eefb6409c1aULL, 774 }, { 0xd01fef10a657842cULL, 800 }, { 0x9b10a4e5e9913129ULL, 827 },
+	{ 0xe7109bfba19c0c9dULL, 853 }, { 0xac2820d9623bf429ULL, 880 }, { 0x80444b5e7aa7cf85ULL, 907 },
+	{ 0xbf21e44003acdd2dULL, 933 }, { 0x8e679c2f5e44ff8fULL, 960 }, { 0xd433179d9c8cb841ULL, 986 },
+	{ 0x9e19db92b4e31ba9ULL, 1013 }, { 0xeb96bf6ebadf77d9ULL, 1039 }, { 0xaf87023b9bf0ee6bULL, 1066 }
+};
+
+static const uint64_t powers_of_ten[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+	10000000000000000000ULL
+};
+
+
+
+static diyfp diyfp_make (uint64_t f, int e)
+{
+	diyfp res = { f, e };
+	return res;
+}
+static diyfp diyfp_mul (diyfp a, diyfp b)
+{
+	// upper 64 bits of the 128 bit product, rounded
+	const uint64_t M32 = 0xffffffffULL;
+	uint64_t ah = a.f >> 32, al = a.f & M32;
+	uint64_t bh = b.f >> 32, bl = b.f & M32;
+	uint64_t hh = ah * bh, lh = al * bh, hl = ah * bl, ll = al * bl;
+	uint64_t mid = (ll >> 32) + (hl & M32) + (lh & M32) + (1ULL << 31);
+
+	return diyfp_make(hh + (hl >> 32) + (lh >> 32) + (mid >> 32),
+	                  a.e + b.e + 64);
+}
+static diyfp diyfp_normalize (diyfp d)
+{
+	while (!(d.f & (1ULL << 63)))
+	{
+		d.f <<= 1;
+		d.e--;
+	}
+	return d;
+}
+
+static diyfp cached_power (int e, int* k)
+{
+	// smallest power of ten that brings the exponent to at least -60
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int ik = (int) dk;
+	if (dk - ik > 0.0)
+		ik++;
+
+	unsigned index = (unsigned) ((ik >> 3) + 1);
+	*k = -(-348 + (int) index * 8);
+	return cached_powers[index];
+}
+
+// moves the last digit down while that gets closer to w, then says
+//  whether the digits are certainly the closest of the shortest
+static int round_weed (char* buf, int len, uint64_t high_w, uint64_t unsafe,
+                        uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+{
+	uint64_t small = high_w - unit, big = high_w + unit;
+
+	while (rest < small && unsafe - rest >= ten_kappa &&
+			(rest + ten_kappa < small ||
+			 small - rest >= rest + ten_kappa - small))
+	{
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+
+	// another digit may be just as close, there's no telling which
+	if (rest < big && unsafe - rest >= ten_kappa &&
+			(rest + ten_kappa < big ||
+			 big - rest > rest + ten_kappa - big))
+		return 0;
+
+	// and the digits have to stay inside despite the error
+	return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+// digits of w, 0 when they may not be the shortest
+static int digit_gen (diyfp low, diyfp w, diyfp high, char* buf, int* len, int* k)
+{
+	const diyfp one = diyfp_make(1ULL << -w.e, w.e);
+	uint64_t unit = 1;
+
+	// widened by the error, round_weed tells what's really inside
+	uint64_t too_high = high.f + unit;
+	uint64_t unsafe = too_high - (low.f - unit);
+	uint32_t p1 = (uint32_t) (too_high >> -one.e);
+	uint64_t p2 = too_high & (one.f - 1);
+	int kappa = 1;
+
+	while (kappa < 10 && p1 >= powers_of_ten[kappa])
+		kappa++;
+	*len = 0;
+
+	// integral part
+	while (kappa > 0)
+	{
+		uint64_t div = powers_of_ten[kappa - 1];
+
+		buf[(*len)++] = (char) ('0' + p1 / div);
+		p1 %= div;
+		kappa--;
+
+		uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+		if (rest < unsafe)
+		{
+			*k += kappa;
+			return round_weed(buf, *len, too_high - w.f, unsafe,
+				rest, div << -one.e, unit);
+		}
+	}
+
+	// fractional part
+	for (;;)
+	{
+		p2 *= 10;
+		unit *= 10;
+		unsafe *= 10;
+
+		buf[(*len)++] = (char) ('0' + (p2 >> -one.e));
+		p2 &= one.f - 1;
+		kappa--;
+
+		if (p2 < unsafe)
+		{
+			*k += kappa;
+			return round_weed(buf, *len, (too_high - w.f) * unit, unsafe,
+				p2, one.f, unit);
+		}
+	}
+}
+
+// digits of the positive, finite, nonzero double 'r', which is then
+//  those digits times 10^k. 0 when Grisu3 can't be sure of them
+static int grisu3 (double r, char* buf, int* k)
+{
+	uint64_t bits;
+	int len;
+	memcpy(&bits, &r, sizeof(bits));
+
+	int be = (int) ((bits >> 52) & 0x7ff);
+	uint64_t sig = bits & DP_SIGNIFICAND;
+	diyfp v = (be != 0) ?
+		diyfp_make(sig + DP_HIDDEN_BIT, be - DP_EXP_BIAS) :
+		diyfp_make(sig, 1 - DP_EXP_BIAS);
+
+	// edges of the interval that rounds to 'r'
+	diyfp plus = diyfp_make((v.f << 1) + 1, v.e - 1);
+	while (!(plus.f & (DP_HIDDEN_BIT << 1)))
+	{
+		plus.f <<= 1;
+		plus.e--;
+	}
+	plus.f <<= 10;
+	plus.e -= 10;
+
+	// the one below is closer at a power of two, except the smallest normal
+	diyfp minus = (sig == 0 && be > 1) ?
+		diyfp_make((v.f << 2) - 1, v.e - 2) :
+		diyfp_make((v.f << 1) - 1, v.e - 1);
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+
+	diyfp c = cached_power(plus.e, k);
+	diyfp w = diyfp_mul(diyfp_normalize(v), c);
+	diyfp wp = diyfp_mul(plus, c);
+	diyfp wm = diyfp_mul(minus, c);
+
+	return digit_gen(wm, w, wp, buf, &len, k) ? len : 0;
+}
+
+// 'prec' digits that read back as 'r', 0 when there are none
+static int digits_printf (double r, int prec, char* buf, int* k)
+{
+	static const int nudge[] = { 0, 1, -1 };
+	char tmp[32];
+	uint64_t d = 0;
+	int i, len;
+	char* p;
+
+	// d.ddde+xx, as an integer times 10^e
+	snprintf(tmp, sizeof(tmp), "%.*e", prec - 1, r);
+	for (p = tmp; *p != 'e'; p++)
+		if (*p != '.')
+			d = d * 10 + (uint64_t) (*p - '0');
+	int e = atoi(p + 1) - (prec - 1);
+
+	// at a power of two the interval is lopsided, the closest
+	//  digits may not read back when the ones next to them do
+	for (i = 0; i < 3; i++)
+	{
+		unsigned long long n = d + nudge[i];
+
+		snprintf(tmp, sizeof(tmp), "%llue%d", n, e);
+		if (n != 0 && strtod(tmp, NULL) == r)
+		{
+			len = snprintf(buf, 20, "%llu", n);
+			for (*k = e; len > 1 && buf[len - 1] == '0'; (*k)++)
+				len--;
+			return len;
+		}
+	}
+
+	return 0;
+}
+// the slow way, when there are 'prec' digits there are 'prec + 1'
+//  too, so the fewest can be searched for
+static int shortest_printf (double r, char* buf, int* k)
+{
+	int lo = 1, hi = 17;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+
+		if (digits_printf(r, mid, buf, k) != 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	// 17 digits always read back
+	return digits_printf(r, lo, buf, k);
+}
+
+
+
+size_t ju_format_real (char* out, ju_real r)
+{
+	char digits[20];
+	char* p = out;
+	int len, k, point, i;
+
+	if (isnan(r))
+	{
+		memcpy(out, "nan", 3);
+		return 3;
+	}
+
+	if (signbit(r))
+	{
+		*p++ = '-';
+		r = -r;
+	}
+
+	if (isinf(r))
+	{
+		memcpy(p, "inf", 3);
+		return (p - out) + 3;
+	}
+	if (r == 0.0)
+	{
+		memcpy(p, "0.0", 3);
+		return (p - out) + 3;
+	}
+
+	len = grisu3(r, digits, &k);
+	if (len == 0)
+		len = shortest_printf(r, digits, &k);
+	point = len + k; // digits before the decimal point
+
+	if (point > 0 && point <= 21)
+	{
+		// 1234.5, 1200.0
+		for (i = 0; i < point; i++)
+			*p++ = (i < len) ? digits[i] : '0';
+		*p++ = '.';
+		if (point >= len)
+			*p++ = '0';
+		for (i = point; i < len; i++)
+			*p++ = digits[i];
+	}
+	else if (point <= 0 && point > -6)
+	{
+		// 0.00012
+		*p++ = '0';
+		*p++ = '.';
+		for (i = point; i < 0; i++)
+			*p++ = '0';
+		for (i = 0; i < len; i++)
+			*p++ = digits[i];
+	}
+	else
+	{
+		// 1.5e-7, 1.0e300
+		int e = point - 1;
+
+		*p++ = digits[0];
+		*p++ = '.';
+		if (len == 1)
+			*p++ = '0';
+		for (i = 1; i < len; i++)
+			*p++ = digits[i];
+
+		*p++ = 'e';
+		if (e < 0)
+		{
+			*p++ = '-';
+			e = -e;
+		}
+		if (e >= 100) *p++ = (char) ('0' + e / 100);
+		if (e >= 10)  *p++ = (char) ('0' + e / 10 % 10);
+		*p++ = (char) ('0' + e % 10);
+	}
+
+	return p - out;
+}
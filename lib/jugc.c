@@ -7,6 +7,7 @@
 #define WHITE   0
 #define GREY    1
 #define BLACK   2
+#define STACK   4   // flag for objects that are never freed
 
 static struct
 {
@@ -18,6 +19,12 @@ ju_obj gc_sets[3];
 bool gc_began;
 size_t gc_nobjs;
 
+// collect once the number of objects has doubled since the last
+//  collection. building with JU_GC_STRESS collects on every
+//  allocation instead, which is good at finding missing roots
+#define GC_MIN_OBJS 4096
+static size_t gc_limit = GC_MIN_OBJS;
+
 #define first(col) gc_sets[col].gc_info.next
 
 
@@ -41,24 +48,48 @@ static void move_to_set (ju_obj* obj, ju_obj* set)
 	if (set_next != NULL)
 		set_next->gc_info.prev = obj;
 }
+static void remove_from_set (ju_obj* obj)
+{
+	ju_obj* prev = obj->gc_info.prev;
+	ju_obj* next = obj->gc_info.next;
+
+	if (prev != NULL)
+	{
+		prev->gc_info.next = next;
+		if (next != NULL)
+			next->gc_info.prev = prev;
+	}
+
+	obj->gc_info.prev =
+	obj->gc_info.next = NULL;
+}
 static void make_white (ju_obj* obj)
 {
-	obj->gc_info.color = WHITE;
-	move_to_set(obj, &gc_sets[WHITE]);
+	if (obj->gc_info.color & STACK)
+	{
+		// stack objects only join the sets while being marked
+		obj->gc_info.color = STACK | WHITE;
+		remove_from_set(obj);
+	}
+	else
+	{
+		obj->gc_info.color = WHITE;
+		move_to_set(obj, &gc_sets[WHITE]);
+	}
 }
 static void make_grey (ju_obj* obj)
 {
-	if (obj->gc_info.color == WHITE)
+	if ((obj->gc_info.color & ~STACK) == WHITE)
 	{
-		obj->gc_info.color = GREY;
+		obj->gc_info.color = GREY | (obj->gc_info.color & STACK);
 		move_to_set(obj, &gc_sets[GREY]);
 	}
 }
 static void make_black (ju_obj* obj)
 {
-	if (obj->gc_info.color == GREY)
+	if ((obj->gc_info.color & ~STACK) == GREY)
 	{
-		obj->gc_info.color = BLACK;
+		obj->gc_info.color = BLACK | (obj->gc_info.color & STACK);
 		move_to_set(obj, &gc_sets[BLACK]);
 
 		ju_int i, nmems;
@@ -71,13 +102,27 @@ static void make_black (ju_obj* obj)
 
 void juGC_init_obj (ju_obj* obj)
 {
+#ifdef JU_GC_STRESS
 	juGC_sweep();
+#else
+	if (gc_nobjs >= gc_limit)
+		juGC_sweep();
+#endif
 
 	gc_nobjs++;
+	obj->gc_info.color = WHITE;
 	obj->gc_info.prev =
 	obj->gc_info.next = NULL;
 	make_white(obj);
 }
+void juGC_init_stack (ju_obj* obj)
+{
+	// never freed, but whatever it points to is
+	//  still marked through it
+	obj->gc_info.color = STACK | WHITE;
+	obj->gc_info.prev =
+	obj->gc_info.next = NULL;
+}
 
 
 
@@ -193,4 +238,8 @@ void juGC_end ()
 //	fprintf(stderr, "* freed %d/%d   %d roots\n",
 //		freed, gc_nobjs, gc_roots.size);
 	gc_nobjs -= freed;
+
+	gc_limit = 2 * gc_nobjs;
+	if (gc_limit < GC_MIN_OBJS)
+		gc_limit = GC_MIN_OBJS;
 }
@@ -0,0 +1,229 @@
+#include "jupiter.h"
+#include <string.h>
+
+/*
+	runtime side of Map(\k, \v) from the stdlib: an open addressing
+	 hash table with linear probing
+
+	  { count, used, keys, vals, hashes }
+
+	keys and vals are arrays, so the collector finds them like any
+	 other members and stores go through juGC_store. hashes is an
+	 IntArray that tells the state of each slot: EMPTY, TOMB for a
+	 removed entry, or the (adjusted) hash of the key in that slot
+
+	hashing and comparing keys happens in the stdlib, where 'hash'
+	 and '==' are overloaded. the runtime only walks the slots with
+	 a matching hash, so '==' is rarely called on the wrong key
+*/
+
+#define EMPTY 0
+#define TOMB  1
+
+#define MAP_MIN 8
+
+#define count(m)  ju_to_int(ju_get(m, 0))
+#define used(m)   ju_to_int(ju_get(m, 1))
+#define keys(m)   ju_array_data(ju_get(m, 2))
+#define vals(m)   ju_array_data(ju_get(m, 3))
+#define hashes(m) ((ju_int*) ju_get_buffer(ju_get(m, 4)))
+#define cap(m)    ((ju_int) ju_get_length(ju_get(m, 4)))
+
+static ju_int stored_hash (juc h)
+{
+	ju_int s = ju_to_int(h);
+	return (s == EMPTY || s == TOMB) ? s + 2 : s;
+}
+
+// first slot to look at, hashes written by hand are mixed
+//  first so that their low bits are all worth something
+static ju_int home (ju_int h, ju_int cap)
+{
+	uint32_t x = (uint32_t) h;
+
+	x ^= x >> 16;
+	x *= 0x85ebca6bU;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35U;
+	x ^= x >> 16;
+
+	return (ju_int) (x & (uint32_t) (cap - 1));
+}
+
+static void rehash (juc m, ju_int newcap)
+{
+	juc res;
+	ju_int i, j, cap = cap(m);
+
+	// 'm' belongs to the caller, so the old entries survive this
+	juGC_root(&res);
+	res = ju_make_map(newcap);
+
+	juc* ks = keys(m);
+	juc* vs = vals(m);
+	ju_int* hs = hashes(m);
+	juc* nks = keys(res);
+	juc* nvs = vals(res);
+	ju_int* nhs = hashes(res);
+
+	for (i = 0; i < cap; i++)
+		if (hs[i] != EMPTY && hs[i] != TOMB)
+		{
+			j = home(hs[i], newcap);
+			while (nhs[j] != EMPTY)
+				j = (j + 1) & (newcap - 1);
+
+			nhs[j] = hs[i];
+			nks[j] = ks[i];
+			nvs[j] = vs[i];
+		}
+
+	ju_put(m, 1, ju_get(m, 0));
+	ju_put(m, 2, ju_get(res, 2));
+	ju_put(m, 3, ju_get(res, 3));
+	ju_put(m, 4, ju_get(res, 4));
+	juGC_unroot(1);
+}
+
+
+
+juc juStd_newMap ()
+{
+	return ju_make_map(MAP_MIN);
+}
+juc juStd_lenMap (juc m)
+{
+	return ju_from_int(count(m));
+}
+
+// next slot (after slot 'from', or starting at home when 'from'
+//  is -1) that may hold a key with hash 'h', -1 when there's none
+juc juStd_probeMap (juc m, juc h, juc from)
+{
+	ju_int cap = cap(m);
+	ju_int* hs = hashes(m);
+	ju_int s = stored_hash(h);
+	ju_int i = ju_to_int(from);
+
+	i = (i < 0) ? home(s, cap) : (i + 1) & (cap - 1);
+
+	// there's always an empty slot, so this stops
+	for (; hs[i] != EMPTY; i = (i + 1) & (cap - 1))
+		if (hs[i] == s)
+			return ju_from_int(i);
+
+	return ju_from_int(-1);
+}
+
+// adds a key that isn't in the map yet
+juc juStd_insertMap (juc m, juc h, juc key, juc val)
+{
+	ju_int cap = cap(m);
+
+	// at most 3/4 of the slots are used (including removed ones),
+	//  and at most half of them after making room
+	if ((used(m) + 1) * 4 > cap * 3)
+	{
+		ju_int newcap = MAP_MIN;
+		while ((count(m) + 1) * 2 > newcap)
+			newcap *= 2;
+
+		rehash(m, newcap);
+		cap = newcap;
+	}
+
+	ju_int* hs = hashes(m);
+	ju_int s = stored_hash(h);
+	ju_int i = home(s, cap);
+
+	while (hs[i] != EMPTY && hs[i] != TOMB)
+		i = (i + 1) & (cap - 1);
+
+	if (hs[i] == EMPTY)
+		ju_put(m, 1, ju_from_int(used(m) + 1));
+	ju_put(m, 0, ju_from_int(count(m) + 1));
+
+	hs[i] = s;
+	juGC_store(keys(m) + i, key);
+	juGC_store(vals(m) + i, val);
+
+	return ju_unit;
+}
+juc juStd_removeMap (juc m, juc ci)
+{
+	ju_int i = ju_to_int(ci);
+
+	hashes(m)[i] = TOMB;
+	keys(m)[i] = ju_null;
+	vals(m)[i] = ju_null;
+	ju_put(m, 0, ju_from_int(count(m) - 1));
+
+	return ju_unit;
+}
+
+// first slot at or after 'from' with an entry, -1 when there's none
+juc juStd_nextMap (juc m, juc from)
+{
+	ju_int cap = cap(m);
+	ju_int* hs = hashes(m);
+	ju_int i;
+
+	for (i = ju_to_int(from); i < cap; i++)
+		if (hs[i] != EMPTY && hs[i] != TOMB)
+			return ju_from_int(i);
+
+	return ju_from_int(-1);
+}
+
+juc juStd_keyMap (juc m, juc ci)
+{
+	return keys(m)[ju_to_int(ci)];
+}
+juc juStd_valMap (juc m, juc ci)
+{
+	return vals(m)[ju_to_int(ci)];
+}
+juc juStd_setValMap (juc m, juc ci, juc val)
+{
+	juGC_store(vals(m) + ju_to_int(ci), val);
+	return ju_unit;
+}
+
+
+
+// hashes, mixed again by home() before they are used
+juc juStd_hashInt (juc ca)
+{
+	return ca;
+}
+juc juStd_hashBool (juc cb)
+{
+	return ju_from_int(cb == ju_false ? 0 : 1);
+}
+juc juStd_hashReal (juc cr)
+{
+	ju_real r = ju_get_real(cr);
+	uint64_t bits;
+
+	// 0.0 == -0.0
+	if (r == 0)
+		r = 0;
+
+	memcpy(&bits, &r, sizeof(bits));
+	return ju_from_int((ju_int) (bits ^ (bits >> 32)));
+}
+juc juStd_hashStr (juc cs)
+{
+	// FNV-1a
+	const unsigned char* buf = (const unsigned char*) ju_get_buffer(cs);
+	size_t i, len = ju_get_length(cs);
+	uint32_t h = 2166136261U;
+
+	for (i = 0; i < len; i++)
+	{
+		h ^= buf[i];
+		h *= 16777619U;
+	}
+
+	return ju_from_int((ju_int) h);
+}
@@ -0,0 +1,118 @@
+#include "jupiter.h"
+#include <string.h>
+
+/*
+	kernels for IntArray and RealArray, which keep raw ju_int's and
+	 ju_real's in their buffer instead of tagged or boxed values
+
+	the loops work on LANES elements at a time using the vector
+	 extension of gcc and clang, which becomes SSE/AVX/NEON code
+	 (or plain scalar code where there is none), then finish the
+	 leftover elements one by one. loads go through memcpy since
+	 the buffers are only aligned like the objects holding them
+
+	sums are accumulated per lane and added up at the end, so the
+	 order in which reals are added differs from a plain loop
+*/
+
+#define LANES 8
+
+typedef ju_int  ints_v  __attribute__ ((vector_size (LANES * sizeof(ju_int))));
+typedef ju_real reals_v __attribute__ ((vector_size (LANES * sizeof(ju_real))));
+
+#define KERNELS(T, V, name) \
+	T ju_sum_##name (const T* a, size_t n) \
+	{ \
+		V acc = { 0 }, va; \
+		T res = 0; \
+		size_t i = 0; \
+		int k; \
+	\
+		for (; i + LANES <= n; i += LANES) \
+		{ \
+			memcpy(&va, a + i, sizeof(V)); \
+			acc += va; \
+		} \
+		for (k = 0; k < LANES; k++) \
+			res += acc[k]; \
+		for (; i < n; i++) \
+			res += a[i]; \
+	\
+		return res; \
+	} \
+	T ju_dot_##name (const T* a, const T* b, size_t n) \
+	{ \
+		V acc = { 0 }, va, vb; \
+		T res = 0; \
+		size_t i = 0; \
+		int k; \
+	\
+		for (; i + LANES <= n; i += LANES) \
+		{ \
+			memcpy(&va, a + i, sizeof(V)); \
+			memcpy(&vb, b + i, sizeof(V)); \
+			acc += va * vb; \
+		} \
+		for (k = 0; k < LANES; k++) \
+			res += acc[k]; \
+		for (; i < n; i++) \
+			res += a[i] * b[i]; \
+	\
+		return res; \
+	} \
+	void ju_fill_##name (T* out, T x, size_t n) \
+	{ \
+		V vx; \
+		size_t i = 0; \
+		int k; \
+	\
+		for (k = 0; k < LANES; k++) \
+			vx[k] = x; \
+	\
+		for (; i + LANES <= n; i += LANES) \
+			memcpy(out + i, &vx, sizeof(V)); \
+		for (; i < n; i++) \
+			out[i] = x; \
+	} \
+	void ju_scale_##name (T* out, const T* a, T x, size_t n) \
+	{ \
+		V vx, va; \
+		size_t i = 0; \
+		int k; \
+	\
+		for (k = 0; k < LANES; k++) \
+			vx[k] = x; \
+	\
+		for (; i + LANES <= n; i += LANES) \
+		{ \
+			memcpy(&va, a + i, sizeof(V)); \
+			va *= vx; \
+			memcpy(out + i, &va, sizeof(V)); \
+		} \
+		for (; i < n; i++) \
+			out[i] = a[i] * x; \
+	} \
+	ELEMENTWISE(T, V, name, add, +) \
+	ELEMENTWISE(T, V, name, sub, -) \
+	ELEMENTWISE(T, V, name, mul, *)
+
+// out[i] = a[i] <op> b[i]
+#define ELEMENTWISE(T, V, name, opname, op) \
+	void ju_##opname##_##name (T* out, const T* a, const T* b, size_t n) \
+	{ \
+		V va, vb; \
+		size_t i = 0; \
+	\
+		for (; i + LANES <= n; i += LANES) \
+		{ \
+			memcpy(&va, a + i, sizeof(V)); \
+			memcpy(&vb, b + i, sizeof(V)); \
+			va = va op vb; \
+			memcpy(out + i, &va, sizeof(V)); \
+		} \
+		for (; i < n; i++) \
+			out[i] = a[i] op b[i]; \
+	}
+
+KERNELS(ju_int, ints_v, ints)
+KERNELS(ju_real, reals_v, reals)
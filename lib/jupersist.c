@@ -0,0 +1,1011 @@
+#include "jupiter.h"
+#include <string.h>
+#include <stdio.h>
+
+/*
+	persistent collections: PVec(\a), a bit-partitioned vector trie
+	 and PMap(\k, \v), a hash array mapped trie (CHAMP layout). an
+	 update copies the path down to what changed and shares the rest,
+	 so both are O(log32 n) for lookup and update
+
+	transients (TVec, TMap) are builders that may change nodes in
+	 place. every transient gets its own edit number, which it puts
+	 in the nodes it makes; nodes with that number belong to it and
+	 are changed in place, any other node is copied first. making the
+	 transient persistent again retires its number, so nothing can
+	 change those nodes after that
+
+	none of the fresh nodes are reachable until they are stored into
+	 something older, and any allocation may run the collector, so
+	 they are kept in roots until then
+*/
+
+#define JU_TAG_PVEC    0xb
+#define JU_TAG_TVEC    0xc
+#define JU_TAG_VNODE   0xd
+#define JU_TAG_PMAP    0xe
+#define JU_TAG_TMAP    0xf
+#define JU_TAG_HNODE   0x10
+#define JU_TAG_HCOLL   0x11
+#define JU_TAG_HCURSOR 0x12
+
+#define BITS  5
+#define WIDTH (1 << BITS)
+#define MASK  (WIDTH - 1)
+
+// deepest a hash can lead: 7 levels of 5 bits, then a collision
+#define MAX_DEPTH 8
+
+#define mems(o)  (((ju_obj*) (o))->mems)
+#define tag(o)   (((ju_obj*) (o))->tag)
+#define count(o) ju_to_int(mems(o)[0])
+#define edit(o)  (*(ju_int*) ju_get_buffer(o))
+
+static ju_int next_edit = 1;
+
+static void die (const char* msg)
+{
+	juStd_flush();
+	fprintf(stderr, "RUNTIME ERROR: %s\n", msg);
+	exit(1);
+}
+static ju_int check_index (juc coll, juc ci)
+{
+	ju_int i = ju_to_int(ci);
+
+	if (i < 0 || i >= count(coll))
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: vector index %d out of bounds (length %d)\n",
+			i, count(coll));
+		exit(1);
+	}
+
+	return i;
+}
+static ju_int check_transient (juc t)
+{
+	if (edit(t) == 0)
+		die("transient used after being made persistent");
+
+	return edit(t);
+}
+
+
+
+
+
+
+//////////////////////////////// PVec ////////////////////////////////
+/*
+	{ count, shift, root, tail }, the last (up to) 32 elements are in
+	 the tail, so pushing only touches the tree once every 32 times
+*/
+static juc vnode_new (ju_int edit)
+{
+	juc node = ju_alloc(JU_TAG_VNODE, sizeof(ju_int), WIDTH);
+	ju_int i;
+
+	for (i = 0; i < WIDTH; i++)
+		mems(node)[i] = ju_null;
+	edit(node) = edit;
+
+	return node;
+}
+static juc vnode_editable (juc node, ju_int edit)
+{
+	if (edit != 0 && edit(node) == edit)
+		return node;
+
+	juc res = ju_alloc(JU_TAG_VNODE, sizeof(ju_int), WIDTH);
+	memcpy(mems(res), mems(node), WIDTH * sizeof(juc));
+	edit(res) = edit;
+
+	return res;
+}
+static juc make_vec (ju_int tag, ju_int cnt, ju_int shift,
+                      juc root, juc tail, ju_int edit)
+{
+	juc res = ju_alloc(tag, sizeof(ju_int), 4);
+
+	mems(res)[0] = ju_from_int(cnt);
+	mems(res)[1] = ju_from_int(shift);
+	mems(res)[2] = root;
+	mems(res)[3] = tail;
+	edit(res) = edit;
+
+	return res;
+}
+
+static ju_int tail_off (ju_int cnt)
+{
+	return (cnt < WIDTH) ? 0 : ((cnt - 1) >> BITS) << BITS;
+}
+static juc* vec_slot (juc vec, ju_int i)
+{
+	ju_int level;
+	juc node;
+
+	if (i >= tail_off(count(vec)))
+		return mems(mems(vec)[3]) + (i & MASK);
+
+	node = mems(vec)[2];
+	for (level = ju_to_int(mems(vec)[1]); level > 0; level -= BITS)
+		node = mems(node)[(i >> level) & MASK];
+
+	return mems(node) + (i & MASK);
+}
+
+static juc new_path (ju_int level, juc node, ju_int edit)
+{
+	juc res;
+
+	if (level == 0)
+		return node;
+
+	juGC_root(&res);
+	res = vnode_new(edit);
+	mems(res)[0] = new_path(level - BITS, node, edit);
+	juGC_unroot(1);
+
+	return res;
+}
+static juc push_tail (ju_int cnt, ju_int level, juc parent, juc tail, ju_int edit)
+{
+	ju_int sub = ((cnt - 1) >> level) & MASK;
+	juc res, child;
+
+	juGC_root(&res);
+	res = vnode_editable(parent, edit);
+
+	if (level == BITS)
+		child = tail;
+	else if ((child = mems(parent)[sub]) != ju_null)
+		child = push_tail(cnt, level - BITS, child, tail, edit);
+	else
+		child = new_path(level - BITS, tail, edit);
+
+	juGC_store(mems(res) + sub, child);
+	juGC_unroot(1);
+
+	return res;
+}
+static juc do_assoc (ju_int level, juc node, ju_int i, juc x, ju_int edit)
+{
+	ju_int sub = (i >> level) & MASK;
+	juc res;
+
+	juGC_root(&res);
+	res = vnode_editable(node, edit);
+
+	if (level == 0)
+		juGC_store(mems(res) + sub, x);
+	else
+		juGC_store(mems(res) + sub,
+			do_assoc(level - BITS, mems(node)[sub], i, x, edit));
+
+	juGC_unroot(1);
+	return res;
+}
+
+// pushes onto the parts of a vector, which have to be in roots
+static void vec_push (ju_int cnt, ju_int* shift, juc* root, juc* tail,
+                       juc x, ju_int edit)
+{
+	ju_int off = tail_off(cnt);
+
+	if (cnt - off < WIDTH)
+	{
+		*tail = vnode_editable(*tail, edit);
+		juGC_store(mems(*tail) + (cnt - off), x);
+		return;
+	}
+
+	// the tail is full, it goes into the tree and a new one is started
+	if ((cnt >> BITS) > (1 << *shift))
+	{
+		juc res;
+
+		juGC_root(&res);
+		res = vnode_new(edit);
+		mems(res)[0] = *root;
+		juGC_store(mems(res) + 1, new_path(*shift, *tail, edit));
+
+		*root = res;
+		*shift += BITS;
+		juGC_unroot(1);
+	}
+	else
+		*root = push_tail(cnt, *shift, *root, *tail, edit);
+
+	*tail = vnode_new(edit);
+	mems(*tail)[0] = x;
+}
+
+// the leaf that holds element i, which has to be in the tree
+static juc leaf_for (juc root, ju_int shift, ju_int i)
+{
+	ju_int level;
+
+	for (level = shift; level > 0; level -= BITS)
+		root = mems(root)[(i >> level) & MASK];
+
+	return root;
+}
+// takes the last leaf out of the tree, null if that leaves 'node' empty
+static juc pop_tail (ju_int cnt, ju_int level, juc node, ju_int edit)
+{
+	ju_int sub = ((cnt - 2) >> level) & MASK;
+	juc res, child = ju_null;
+
+	if (level > BITS)
+	{
+		child = pop_tail(cnt, level - BITS, mems(node)[sub], edit);
+		if (child == ju_null && sub == 0)
+			return ju_null;
+	}
+	else if (sub == 0)
+		return ju_null;
+
+	juGC_root(&child);
+	res = vnode_editable(node, edit);
+	juGC_store(mems(res) + sub, child);
+	juGC_unroot(1);
+
+	return res;
+}
+// pops off the parts of a vector, which have to be in roots
+static void vec_pop (ju_int cnt, ju_int* shift, juc* root, juc* tail, ju_int edit)
+{
+	ju_int off = tail_off(cnt);
+	juc leaf;
+
+	if (cnt == 0)
+		die("pop from an empty vector");
+
+	if (cnt == 1 || cnt - off > 1)
+	{
+		*tail = vnode_editable(*tail, edit);
+		mems(*tail)[cnt - 1 - off] = ju_null;
+		return;
+	}
+
+	// the tail is used up, the last leaf comes out of the tree to
+	//  take its place. a transient has to own its tail
+	juGC_root(&leaf);
+	leaf = leaf_for(*root, *shift, cnt - 2);
+	*root = pop_tail(cnt, *shift, *root, edit);
+	if (*root == ju_null)
+		*root = vnode_new(edit);
+	else if (*shift > BITS && mems(*root)[1] == ju_null)
+	{
+		*root = mems(*root)[0];
+		*shift -= BITS;
+	}
+	*tail = (edit == 0) ? leaf : vnode_editable(leaf, edit);
+	juGC_unroot(1);
+}
+
+juc juStd_newPVec ()
+{
+	juc root, tail, res;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = vnode_new(0);
+	tail = vnode_new(0);
+	res = make_vec(JU_TAG_PVEC, 0, BITS, root, tail, 0);
+	juGC_unroot(2);
+
+	return res;
+}
+juc juStd_lenPVec (juc vec)
+{
+	return mems(vec)[0];
+}
+juc juStd_getPVec (juc vec, juc ci)
+{
+	return *vec_slot(vec, check_index(vec, ci));
+}
+juc juStd_setPVec (juc vec, juc ci, juc x)
+{
+	ju_int i = check_index(vec, ci);
+	ju_int cnt = count(vec);
+	ju_int shift = ju_to_int(mems(vec)[1]);
+	juc root, tail, res;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = mems(vec)[2];
+	tail = mems(vec)[3];
+
+	if (i >= tail_off(cnt))
+	{
+		tail = vnode_editable(tail, 0);
+		mems(tail)[i & MASK] = x;
+	}
+	else
+		root = do_assoc(shift, root, i, x, 0);
+
+	res = make_vec(JU_TAG_PVEC, cnt, shift, root, tail, 0);
+	juGC_unroot(2);
+
+	return res;
+}
+juc juStd_pushPVec (juc vec, juc x)
+{
+	ju_int cnt = count(vec);
+	ju_int shift = ju_to_int(mems(vec)[1]);
+	juc root, tail, res;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = mems(vec)[2];
+	tail = mems(vec)[3];
+
+	vec_push(cnt, &shift, &root, &tail, x, 0);
+	res = make_vec(JU_TAG_PVEC, cnt + 1, shift, root, tail, 0);
+	juGC_unroot(2);
+
+	return res;
+}
+
+juc juStd_popPVec (juc vec)
+{
+	ju_int cnt = count(vec);
+	ju_int shift = ju_to_int(mems(vec)[1]);
+	juc root, tail, res;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = mems(vec)[2];
+	tail = mems(vec)[3];
+
+	vec_pop(cnt, &shift, &root, &tail, 0);
+	res = make_vec(JU_TAG_PVEC, cnt - 1, shift, root, tail, 0);
+	juGC_unroot(2);
+
+	return res;
+}
+
+juc juStd_transientPVec (juc vec)
+{
+	ju_int edit = next_edit++;
+	juc root, tail, res;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = vnode_editable(mems(vec)[2], edit);
+	tail = vnode_editable(mems(vec)[3], edit);
+	res = make_vec(JU_TAG_TVEC, count(vec), ju_to_int(mems(vec)[1]),
+		root, tail, edit);
+	juGC_unroot(2);
+
+	return res;
+}
+juc juStd_persistentTVec (juc t)
+{
+	check_transient(t);
+	edit(t) = 0;
+
+	return make_vec(JU_TAG_PVEC, count(t), ju_to_int(mems(t)[1]),
+		mems(t)[2], mems(t)[3], 0);
+}
+juc juStd_setTVec (juc t, juc ci, juc x)
+{
+	ju_int edit = check_transient(t);
+	ju_int i = check_index(t, ci);
+
+	if (i >= tail_off(count(t)))
+		juGC_store(mems(mems(t)[3]) + (i & MASK), x);
+	else
+		juGC_store(mems(t) + 2,
+			do_assoc(ju_to_int(mems(t)[1]), mems(t)[2], i, x, edit));
+
+	return ju_unit;
+}
+juc juStd_pushTVec (juc t, juc x)
+{
+	ju_int edit = check_transient(t);
+	ju_int cnt = count(t);
+	ju_int shift = ju_to_int(mems(t)[1]);
+	juc root, tail;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = mems(t)[2];
+	tail = mems(t)[3];
+
+	vec_push(cnt, &shift, &root, &tail, x, edit);
+	mems(t)[0] = ju_from_int(cnt + 1);
+	mems(t)[1] = ju_from_int(shift);
+	juGC_store(mems(t) + 2, root);
+	juGC_store(mems(t) + 3, tail);
+	juGC_unroot(2);
+
+	return ju_unit;
+}
+juc juStd_popTVec (juc t)
+{
+	ju_int edit = check_transient(t);
+	ju_int cnt = count(t);
+	ju_int shift = ju_to_int(mems(t)[1]);
+	juc root, tail;
+
+	juGC_root(&root);
+	juGC_root(&tail);
+	root = mems(t)[2];
+	tail = mems(t)[3];
+
+	vec_pop(cnt, &shift, &root, &tail, edit);
+	mems(t)[0] = ju_from_int(cnt - 1);
+	mems(t)[1] = ju_from_int(shift);
+	juGC_store(mems(t) + 2, root);
+	juGC_store(mems(t) + 3, tail);
+	juGC_unroot(2);
+
+	return ju_unit;
+}
+
+
+
+
+
+
+//////////////////////////////// PMap ////////////////////////////////
+/*
+	{ count, root }, where nodes are either
+	  bitmap nodes: [ k0, v0, k1, v1, ... child0, child1, ... ]
+	    the buffer has the edit number, a bitmap of the 5 bit hash
+	    pieces that have an entry and one of those that have a child,
+	    and the full hash of each entry
+	  collision nodes: [ k0, v0, k1, v1, ... ]
+	    entries whose keys have exactly the same hash
+
+	keys are compared in the stdlib, which asks for the entries
+	 that may match a hash (see juStd_probePMap) and passes the one
+	 that does (or -1) back to put and remove. removing keeps the
+	 trie canonical: a child with a single entry is put back into
+	 its parent
+*/
+typedef struct
+{
+	ju_int edit;
+	uint32_t datamap;
+	uint32_t nodemap;
+	uint32_t hashes[];
+} hinfo;
+
+#define info(n)    ((hinfo*) ju_get_buffer(n))
+#define ndata(n)   (tag(n) == JU_TAG_HCOLL ? ((ju_obj*) (n))->nmems / 2 : \
+                    __builtin_popcount(info(n)->datamap))
+#define nnodes(n)  __builtin_popcount(info(n)->nodemap)
+#define bit_of(h, shift)   (1u << (((h) >> (shift)) & MASK))
+#define index_of(map, bit) __builtin_popcount((map) & ((bit) - 1))
+
+static uint32_t hash_of (juc ch)
+{
+	return (uint32_t) ju_to_int(ch);
+}
+
+static juc hnode_alloc (ju_int tag, ju_int nd, ju_int nn, ju_int edit)
+{
+	ju_int i, nmems = 2 * nd + nn;
+	juc node = ju_alloc(tag, sizeof(hinfo) + nd * sizeof(uint32_t), nmems);
+
+	for (i = 0; i < nmems; i++)
+		mems(node)[i] = ju_null;
+
+	info(node)->edit = edit;
+	info(node)->datamap = 0;
+	info(node)->nodemap = 0;
+	return node;
+}
+static juc hnode_editable (juc node, ju_int edit)
+{
+	if (edit != 0 && info(node)->edit == edit)
+		return node;
+
+	ju_int nd = ndata(node), nmems = ((ju_obj*) node)->nmems;
+	size_t aug = sizeof(hinfo) + nd * sizeof(uint32_t);
+	juc res = ju_alloc(tag(node), aug, nmems);
+
+	memcpy(mems(res), mems(node), nmems * sizeof(juc));
+	memcpy(info(res), info(node), aug);
+	info(res)->edit = edit;
+	return res;
+}
+
+// copy of 'node' with an entry added at 'bit', the new
+//  entry is left for the caller to fill in
+static juc hnode_add_data (juc node, uint32_t bit, uint32_t h, ju_int edit)
+{
+	hinfo* old = info(node);
+	ju_int nd = ndata(node), nn = nnodes(node);
+	ju_int at = index_of(old->datamap, bit);
+	juc res = hnode_alloc(JU_TAG_HNODE, nd + 1, nn, edit);
+	hinfo* inf = info(res);
+
+	memcpy(mems(res), mems(node), 2 * at * sizeof(juc));
+	memcpy(mems(res) + 2 * at + 2, mems(node) + 2 * at,
+		(2 * (nd - at) + nn) * sizeof(juc));
+	memcpy(inf->hashes, old->hashes, at * sizeof(uint32_t));
+	memcpy(inf->hashes + at + 1, old->hashes + at, (nd - at) * sizeof(uint32_t));
+
+	inf->datamap = old->datamap | bit;
+	inf->nodemap = old->nodemap;
+	inf->hashes[at] = h;
+	return res;
+}
+// copy of 'node' without the entry at 'bit'
+static juc hnode_remove_data (juc node, uint32_t bit, ju_int edit)
+{
+	hinfo* old = info(node);
+	ju_int nd = ndata(node), nn = nnodes(node);
+	ju_int at = index_of(old->datamap, bit);
+	juc res = hnode_alloc(JU_TAG_HNODE, nd - 1, nn, edit);
+	hinfo* inf = info(res);
+
+	memcpy(mems(res), mems(node), 2 * at * sizeof(juc));
+	memcpy(mems(res) + 2 * at, mems(node) + 2 * at + 2,
+		(2 * (nd - at - 1) + nn) * sizeof(juc));
+	memcpy(inf->hashes, old->hashes, at * sizeof(uint32_t));
+	memcpy(inf->hashes + at, old->hashes + at + 1, (nd - at - 1) * sizeof(uint32_t));
+
+	inf->datamap = old->datamap & ~bit;
+	inf->nodemap = old->nodemap;
+	return res;
+}
+// copy of 'node' with the entry at 'bit' replaced by 'child'
+static juc hnode_data_to_node (juc node, uint32_t bit, juc child, ju_int edit)
+{
+	hinfo* old = info(node);
+	ju_int nd = ndata(node), nn = nnodes(node);
+	ju_int at = index_of(old->datamap, bit);
+	ju_int nat = index_of(old->nodemap, bit);
+	juc res = hnode_alloc(JU_TAG_HNODE, nd - 1, nn + 1, edit);
+	hinfo* inf = info(res);
+	juc* from = mems(node) + 2 * nd;
+	juc* to = mems(res) + 2 * (nd - 1);
+
+	memcpy(mems(res), mems(node), 2 * at * sizeof(juc));
+	memcpy(mems(res) + 2 * at, mems(node) + 2 * at + 2,
+		2 * (nd - at - 1) * sizeof(juc));
+	memcpy(to, from, nat * sizeof(juc));
+	to[nat] = child;
+	memcpy(to + nat + 1, from + nat, (nn - nat) * sizeof(juc));
+	memcpy(inf->hashes, old->hashes, at * sizeof(uint32_t));
+	memcpy(inf->hashes + at, old->hashes + at + 1, (nd - at - 1) * sizeof(uint32_t));
+
+	inf->datamap = old->datamap & ~bit;
+	inf->nodemap = old->nodemap | bit;
+	return res;
+}
+// copy of 'node' with the child at 'bit' replaced by the
+//  entry (k, v) with hash 'h'
+static juc hnode_node_to_data (juc node, uint32_t bit, uint32_t h,
+                                juc k, juc v, ju_int edit)
+{
+	hinfo* old = info(node);
+	ju_int nd = ndata(node), nn = nnodes(node);
+	ju_int at = index_of(old->datamap, bit);
+	ju_int nat = index_of(old->nodemap, bit);
+	juc res = hnode_alloc(JU_TAG_HNODE, nd + 1, nn - 1, edit);
+	hinfo* inf = info(res);
+	juc* from = mems(node) + 2 * nd;
+	juc* to = mems(res) + 2 * (nd + 1);
+
+	memcpy(mems(res), mems(node), 2 * at * sizeof(juc));
+	mems(res)[2 * at] = k;
+	mems(res)[2 * at + 1] = v;
+	memcpy(mems(res) + 2 * at + 2, mems(node) + 2 * at,
+		2 * (nd - at) * sizeof(juc));
+	memcpy(to, from, nat * sizeof(juc));
+	memcpy(to + nat, from + nat + 1, (nn - nat - 1) * sizeof(juc));
+	memcpy(inf->hashes, old->hashes, at * sizeof(uint32_t));
+	inf->hashes[at] = h;
+	memcpy(inf->hashes + at + 1, old->hashes + at, (nd - at) * sizeof(uint32_t));
+
+	inf->datamap = old->datamap | bit;
+	inf->nodemap = old->nodemap & ~bit;
+	return res;
+}
+
+// node at level 'shift' holding two entries
+static juc hnode_merge (ju_int shift, uint32_t h1, juc k1, juc v1,
+                         uint32_t h2, juc k2, juc v2, ju_int edit)
+{
+	juc res;
+
+	if (h1 == h2)
+	{
+		res = hnode_alloc(JU_TAG_HCOLL, 2, 0, edit);
+		info(res)->hashes[0] = h1;
+		mems(res)[0] = k1;
+		mems(res)[1] = v1;
+		mems(res)[2] = k2;
+		mems(res)[3] = v2;
+		return res;
+	}
+
+	uint32_t b1 = bit_of(h1, shift), b2 = bit_of(h2, shift);
+
+	if (b1 == b2)
+	{
+		juGC_root(&res);
+		res = hnode_alloc(JU_TAG_HNODE, 0, 1, edit);
+		info(res)->nodemap = b1;
+		mems(res)[0] = hnode_merge(shift + BITS, h1, k1, v1, h2, k2, v2, edit);
+		juGC_unroot(1);
+		return res;
+	}
+
+	res = hnode_alloc(JU_TAG_HNODE, 2, 0, edit);
+	info(res)->datamap = b1 | b2;
+
+	ju_int i = (b1 < b2) ? 0 : 1;
+	info(res)->hashes[i] = h1;
+	info(res)->hashes[1 - i] = h2;
+	mems(res)[2 * i] = k1;
+	mems(res)[2 * i + 1] = v1;
+	mems(res)[2 - 2 * i] = k2;
+	mems(res)[3 - 2 * i] = v2;
+	return res;
+}
+
+// where the entries with hash 'h' are, or NULL if nowhere
+static juc hfind (juc node, uint32_t h, ju_int* at)
+{
+	ju_int shift = 0;
+
+	for (;;)
+	{
+		if (tag(node) == JU_TAG_HCOLL)
+		{
+			*at = 0;
+			return info(node)->hashes[0] == h ? node : NULL;
+		}
+
+		hinfo* inf = info(node);
+		uint32_t bit = bit_of(h, shift);
+
+		if (inf->datamap & bit)
+		{
+			*at = index_of(inf->datamap, bit);
+			return inf->hashes[*at] == h ? node : NULL;
+		}
+		if (!(inf->nodemap & bit))
+			return NULL;
+
+		node = mems(node)[2 * ndata(node) + index_of(inf->nodemap, bit)];
+		shift += BITS;
+	}
+}
+// the 'i'th entry that may have a key with hash 'h'
+static juc* hentry (juc m, uint32_t h, ju_int i)
+{
+	ju_int at;
+	juc node = hfind(mems(m)[1], h, &at);
+
+	return mems(node) + 2 * (at + i);
+}
+
+/*
+	adds (k, v) to the trie at 'node' (at level 'shift'), or replaces
+	 the value of candidate 'cand' (see juStd_probePMap)
+*/
+static juc hassoc (juc node, ju_int shift, uint32_t h, juc k, juc v,
+                    ju_int cand, ju_int edit)
+{
+	juc res, sub;
+
+	if (tag(node) == JU_TAG_HCOLL)
+	{
+		ju_int n = ndata(node);
+
+		if (info(node)->hashes[0] != h)
+		{
+			// a different hash got here, make room for it above
+			//  the collision node
+			juGC_root(&res);
+			res = hnode_alloc(JU_TAG_HNODE, 0, 1, edit);
+			info(res)->nodemap = bit_of(info(node)->hashes[0], shift);
+			mems(res)[0] = node;
+			res = hassoc(res, shift, h, k, v, -1, edit);
+			juGC_unroot(1);
+			return res;
+		}
+
+		if (cand >= 0)
+		{
+			res = hnode_editable(node, edit);
+			juGC_store(mems(res) + 2 * cand + 1, v);
+			return res;
+		}
+
+		res = hnode_alloc(JU_TAG_HCOLL, n + 1, 0, edit);
+		memcpy(mems(res), mems(node), 2 * n * sizeof(juc));
+		info(res)->hashes[0] = h;
+		mems(res)[2 * n] = k;
+		mems(res)[2 * n + 1] = v;
+		return res;
+	}
+
+	hinfo* inf = info(node);
+	uint32_t bit = bit_of(h, shift);
+
+	if (inf->datamap & bit)
+	{
+		ju_int at = index_of(inf->datamap, bit);
+
+		if (cand >= 0)
+		{
+			res = hnode_editable(node, edit);
+			juGC_store(mems(res) + 2 * at + 1, v);
+			return res;
+		}
+
+		// two keys in the same place, they go down a level
+		juGC_root(&sub);
+		sub = hnode_merge(shift + BITS, inf->hashes[at],
+			mems(node)[2 * at], mems(node)[2 * at + 1], h, k, v, edit);
+		res = hnode_data_to_node(node, bit, sub, edit);
+		juGC_unroot(1);
+		return res;
+	}
+
+	if (inf->nodemap & bit)
+	{
+		ju_int at = 2 * ndata(node) + index_of(inf->nodemap, bit);
+
+		juGC_root(&sub);
+		sub = hassoc(mems(node)[at], shift + BITS, h, k, v, cand, edit);
+		res = hnode_editable(node, edit);
+		juGC_store(mems(res) + at, sub);
+		juGC_unroot(1);
+		return res;
+	}
+
+	ju_int at = index_of(inf->datamap, bit);
+
+	res = hnode_add_data(node, bit, h, edit);
+	mems(res)[2 * at] = k;
+	mems(res)[2 * at + 1] = v;
+	return res;
+}
+
+// removes candidate 'cand' with hash 'h' from the trie at 'node'
+static juc hdissoc (juc node, ju_int shift, uint32_t h, ju_int cand, ju_int edit)
+{
+	juc res, sub;
+
+	if (tag(node) == JU_TAG_HCOLL)
+	{
+		ju_int n = ndata(node);
+
+		res = hnode_alloc(JU_TAG_HCOLL, n - 1, 0, edit);
+		memcpy(mems(res), mems(node), 2 * cand * sizeof(juc));
+		memcpy(mems(res) + 2 * cand, mems(node) + 2 * cand + 2,
+			2 * (n - cand - 1) * sizeof(juc));
+		info(res)->hashes[0] = h;
+		return res;
+	}
+
+	hinfo* inf = info(node);
+	uint32_t bit = bit_of(h, shift);
+
+	if (inf->datamap & bit)
+		return hnode_remove_data(node, bit, edit);
+
+	ju_int at = 2 * ndata(node) + index_of(inf->nodemap, bit);
+
+	juGC_root(&sub);
+	sub = hdissoc(mems(node)[at], shift + BITS, h, cand, edit);
+
+	if (ndata(sub) == 1 && (tag(sub) == JU_TAG_HCOLL || nnodes(sub) == 0))
+		// a single entry left, it moves up into this node
+		res = hnode_node_to_data(node, bit, info(sub)->hashes[0],
+			mems(sub)[0], mems(sub)[1], edit);
+	else
+	{
+		res = hnode_editable(node, edit);
+		juGC_store(mems(res) + at, sub);
+	}
+
+	juGC_unroot(1);
+	return res;
+}
+
+static juc make_map (ju_int tag, ju_int cnt, juc root, ju_int edit)
+{
+	juc res = ju_alloc(tag, sizeof(ju_int), 2);
+
+	mems(res)[0] = ju_from_int(cnt);
+	mems(res)[1] = root;
+	edit(res) = edit;
+
+	return res;
+}
+
+juc juStd_newPMap ()
+{
+	juc root, res;
+
+	juGC_root(&root);
+	root = hnode_alloc(JU_TAG_HNODE, 0, 0, 0);
+	res = make_map(JU_TAG_PMAP, 0, root, 0);
+	juGC_unroot(1);
+
+	return res;
+}
+juc juStd_lenPMap (juc m)
+{
+	return mems(m)[0];
+}
+
+// next candidate after 'from' (-1 to start) for a key with hash
+//  'h', or -1 when there are no more. candidates are numbered
+//  from 0, there is more than one only if the hashes collide
+juc juStd_probePMap (juc m, juc ch, juc from)
+{
+	ju_int at, next = ju_to_int(from) + 1;
+	juc node = hfind(mems(m)[1], hash_of(ch), &at);
+
+	if (node == NULL)
+		return ju_from_int(-1);
+
+	if (tag(node) == JU_TAG_HCOLL)
+		return ju_from_int(next < ndata(node) ? next : -1);
+	else
+		return ju_from_int(next == 0 ? 0 : -1);
+}
+juc juStd_keyPMap (juc m, juc ch, juc ci)
+{
+	return hentry(m, hash_of(ch), ju_to_int(ci))[0];
+}
+juc juStd_valPMap (juc m, juc ch, juc ci)
+{
+	return hentry(m, hash_of(ch), ju_to_int(ci))[1];
+}
+
+juc juStd_putPMap (juc m, juc ch, juc k, juc v, juc ccand)
+{
+	ju_int cand = ju_to_int(ccand);
+	juc root, res;
+
+	juGC_root(&root);
+	root = hassoc(mems(m)[1], 0, hash_of(ch), k, v, cand, 0);
+	res = make_map(JU_TAG_PMAP, count(m) + (cand < 0 ? 1 : 0), root, 0);
+	juGC_unroot(1);
+
+	return res;
+}
+juc juStd_removePMap (juc m, juc ch, juc ccand)
+{
+	juc root, res;
+
+	juGC_root(&root);
+	root = hdissoc(mems(m)[1], 0, hash_of(ch), ju_to_int(ccand), 0);
+	res = make_map(JU_TAG_PMAP, count(m) - 1, root, 0);
+	juGC_unroot(1);
+
+	return res;
+}
+
+juc juStd_transientPMap (juc m)
+{
+	// nodes are copied once they are changed
+	return make_map(JU_TAG_TMAP, count(m), mems(m)[1], next_edit++);
+}
+juc juStd_persistentTMap (juc t)
+{
+	check_transient(t);
+	edit(t) = 0;
+
+	return make_map(JU_TAG_PMAP, count(t), mems(t)[1], 0);
+}
+juc juStd_putTMap (juc t, juc ch, juc k, juc v, juc ccand)
+{
+	ju_int edit = check_transient(t);
+	ju_int cand = ju_to_int(ccand);
+
+	juGC_store(mems(t) + 1,
+		hassoc(mems(t)[1], 0, hash_of(ch), k, v, cand, edit));
+	if (cand < 0)
+		mems(t)[0] = ju_from_int(count(t) + 1);
+
+	return ju_unit;
+}
+juc juStd_removeTMap (juc t, juc ch, juc ccand)
+{
+	ju_int edit = check_transient(t);
+
+	juGC_store(mems(t) + 1,
+		hdissoc(mems(t)[1], 0, hash_of(ch), ju_to_int(ccand), edit));
+	mems(t)[0] = ju_from_int(count(t) - 1);
+
+	return ju_unit;
+}
+
+
+
+/*
+	walking over the entries of a PMap: the nodes from the root down
+	 to the current one, and how far along each of them it is. the
+	 entries of a node come first, then its children
+*/
+typedef struct
+{
+	ju_int depth;
+	ju_int pos[MAX_DEPTH];
+} hcursor;
+
+#define cursor_of(c) ((hcursor*) ju_get_buffer(c))
+
+// moves on to the next entry, starting from the current position
+static void hcursor_settle (juc c)
+{
+	hcursor* cur = cursor_of(c);
+
+	while (cur->depth > 0)
+	{
+		ju_int top = cur->depth - 1;
+		juc node = mems(c)[top];
+		ju_int p = cur->pos[top];
+		ju_int nd = ndata(node);
+
+		if (p < nd)
+			return;
+
+		if (tag(node) == JU_TAG_HNODE && p < nd + nnodes(node))
+		{
+			cur->pos[top]++;
+			juGC_store(mems(c) + top + 1, mems(node)[2 * nd + (p - nd)]);
+			cur->pos[top + 1] = 0;
+			cur->depth++;
+		}
+		else
+		{
+			mems(c)[top] = ju_null;
+			cur->depth--;
+		}
+	}
+}
+
+juc juStd_cursorPMap (juc m)
+{
+	juc c = ju_alloc(JU_TAG_HCURSOR, sizeof(hcursor), MAX_DEPTH);
+	ju_int i;
+
+	for (i = 0; i < MAX_DEPTH; i++)
+		mems(c)[i] = ju_null;
+
+	mems(c)[0] = mems(m)[1];
+	cursor_of(c)->depth = 1;
+	cursor_of(c)->pos[0] = 0;
+	hcursor_settle(c);
+
+	return c;
+}
+juc juStd_moreCursor (juc c)
+{
+	return ju_from_bool(cursor_of(c)->depth > 0);
+}
+juc juStd_keyCursor (juc c)
+{
+	hcursor* cur = cursor_of(c);
+	ju_int top = cur->depth - 1;
+	return mems(mems(c)[top])[2 * cur->pos[top]];
+}
+juc juStd_valCursor (juc c)
+{
+	hcursor* cur = cursor_of(c);
+	ju_int top = cur->depth - 1;
+	return mems(mems(c)[top])[2 * cur->pos[top] + 1];
+}
+juc juStd_advanceCursor (juc c)
+{
+	cursor_of(c)->pos[cursor_of(c)->depth - 1]++;
+	hcursor_settle(c);
+	return c;
+}
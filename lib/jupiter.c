@@ -8,6 +8,20 @@
 #define JU_TAG_STR     0x2
 #define JU_TAG_REAL    0x3
 #define JU_TAG_CLOSURE 0x4
+#define JU_TAG_ROPE    0x5
+#define JU_TAG_ARRAY   0x6
+#define JU_TAG_SLOTS   0x7
+#define JU_TAG_INTS    0x8
+#define JU_TAG_REALS   0x9
+#define JU_TAG_MAP     0xa
+// 0xb - 0x12 are the persistent collections in jupersist.c
+// 0x13 is the line reader in justd.c
+
+// concatenations shorter than this are just copied
+#define ROPE_MIN 64
+
+// smallest number of slots given to an array
+#define ARRAY_MIN 8
 
 
 // utilities
@@ -42,12 +56,18 @@ ju_int ju_get_tag (juc cell)
 	else
 		return ((ju_obj*) cell)->tag;
 }
+static ju_obj* rope_flatten (ju_obj* rope);
+
 char* ju_get_buffer (juc cell)
 {
 	if (cell == ju_null || ju_is_int(cell))
 		return NULL;
 
-	ju_obj* const obj = cell;
+	ju_obj* obj = cell;
+
+	// the characters of a rope are put together once they are needed
+	if (obj->tag == JU_TAG_ROPE)
+		obj = rope_flatten(obj);
 
 	// memory located after sub-members
 	return (char*)(obj->mems + obj->nmems);
@@ -75,6 +95,7 @@ void ju_init ()
 }
 void ju_destroy ()
 {
+	juStd_flush();
 	juGC_destroy();
 }
 
@@ -86,7 +107,9 @@ void ju_destroy ()
 
 // object management
 
-static juc ju_vmake (ju_int tag, size_t aug, ju_int nmems, va_list vl)
+// members are left for the caller to fill in, which has to
+//  happen before anything else is allocated
+juc ju_alloc (ju_int tag, ju_int aug, ju_int nmems)
 {
 	ju_obj* obj = malloc(sizeof(ju_obj) + nmems * sizeof(juc) + aug);
 
@@ -94,6 +117,20 @@ static juc ju_vmake (ju_int tag, size_t aug, ju_int nmems, va_list vl)
 	obj->tag = tag;
 	juGC_init_obj(obj);
 
+	return (juc) obj;
+}
+
+juc ju_alloc_closure (ju_fnp fn, ju_int nmems)
+{
+	juc obj = ju_alloc(JU_TAG_CLOSURE, sizeof(ju_fnp), nmems);
+	*((ju_fnp*) ju_get_buffer(obj)) = fn;
+	return obj;
+}
+
+static juc ju_vmake (ju_int tag, size_t aug, ju_int nmems, va_list vl)
+{
+	ju_obj* obj = ju_alloc(tag, aug, nmems);
+
 	ju_int i;
 	for (i = 0; i < nmems; i++)
 		obj->mems[i] = va_arg(vl, juc);
@@ -119,7 +156,8 @@ juc ju_make_buf (ju_int tag, size_t aug, ju_int nmems, ...)
 
 juc ju_make_str (const char* buf, size_t size)
 {
-	juc obj = ju_make_buf(JU_TAG_STR, size, 1, ju_from_int((ju_int) size));
+	ju_obj* obj = ju_alloc(JU_TAG_STR, size, 1);
+	obj->mems[0] = ju_from_int((ju_int) size);
 
 	if (buf != NULL)
 		memcpy(ju_get_buffer(obj), buf, size);
@@ -127,14 +165,187 @@ juc ju_make_str (const char* buf, size_t size)
 	return obj;
 }
 
+/*
+	a rope is a string made by '++' that hasn't been copied yet:
+	  { length, left, right }
+	once flattened it becomes { length, <flat string>, null }
+*/
+juc ju_concat_str (juc a, juc b)
+{
+	size_t la = ju_get_length(a);
+	size_t lb = ju_get_length(b);
+
+	if (lb == 0) return a;
+	if (la == 0) return b;
+
+	if (la + lb < ROPE_MIN)
+	{
+		juc res = ju_make_str(NULL, la + lb);
+		char* buf = ju_get_buffer(res);
+
+		memcpy(buf, ju_get_buffer(a), la);
+		memcpy(buf + la, ju_get_buffer(b), lb);
+		return res;
+	}
+
+	ju_obj* obj = ju_alloc(JU_TAG_ROPE, 0, 3);
+	obj->mems[0] = ju_from_int((ju_int) (la + lb));
+	obj->mems[1] = a;
+	obj->mems[2] = b;
+	return (juc) obj;
+}
+static ju_obj* rope_flatten (ju_obj* rope)
+{
+	if (rope->mems[2] == ju_null)
+		return rope->mems[1];
+
+	size_t end = ju_get_length(rope);
+	size_t size = 0, cap = 16;
+	juc* stack;
+
+	// the rope is still reachable from whoever asked, so
+	//  its pieces survive this allocation
+	ju_obj* flat = ju_make_str(NULL, end);
+	char* buf = ju_get_buffer(flat);
+
+	// fill in from the back, so the left leaning ropes made
+	//  by 's = s ++ x' only need a couple of entries
+	stack = malloc(cap * sizeof(juc));
+	stack[size++] = rope;
+
+	while (size > 0)
+	{
+		ju_obj* s = stack[--size];
+
+		if (s->tag == JU_TAG_ROPE && s->mems[2] != ju_null)
+		{
+			if (size + 2 > cap)
+			{
+				cap *= 2;
+				stack = realloc(stack, cap * sizeof(juc));
+			}
+			stack[size++] = s->mems[1];
+			stack[size++] = s->mems[2];
+		}
+		else
+		{
+			size_t len = ju_get_length(s);
+			end -= len;
+			memcpy(buf + end, ju_get_buffer(s), len);
+		}
+	}
+	free(stack);
+
+	juGC_store(rope->mems + 1, flat);
+	juGC_store(rope->mems + 2, ju_null);
+	return flat;
+}
+
+/*
+	an array is { length, slots }, where the slots are an object with
+	 a member for every element, so the collector finds the elements
+	 the same way as any other members. slots past the length are
+	 null, push fills them in and doubles the slots once they run out
+*/
+static ju_obj* array_slots (ju_int cap, ju_obj* from, ju_int len)
+{
+	ju_obj* slots = ju_alloc(JU_TAG_SLOTS, 0, cap);
+	ju_int i = 0;
+
+	if (from != NULL)
+		for (; i < len; i++)
+			slots->mems[i] = from->mems[i];
+	for (; i < cap; i++)
+		slots->mems[i] = ju_null;
+
+	return slots;
+}
+juc ju_make_array (ju_int len, juc fill)
+{
+	juc res;
+	ju_int i;
+
+	// the array has to stay alive while the slots are made
+	juGC_root(&res);
+	res = ju_make(JU_TAG_ARRAY, 2, ju_from_int(0), ju_null);
+
+	ju_obj* slots = array_slots(len < ARRAY_MIN ? ARRAY_MIN : len, NULL, 0);
+	for (i = 0; i < len; i++)
+		slots->mems[i] = fill;
+
+	ju_put(res, 0, ju_from_int(len));
+	ju_put(res, 1, slots);
+	juGC_unroot(1);
+
+	return res;
+}
+juc* ju_array_data (juc arr)
+{
+	ju_obj* slots = ju_get(arr, 1);
+	return slots->mems;
+}
+void ju_array_push (juc arr, juc val)
+{
+	ju_obj* obj = arr;
+	ju_obj* slots = obj->mems[1];
+	ju_int len = ju_get_length(arr);
+
+	if (len == slots->nmems)
+	{
+		// 'arr' belongs to the caller, so its slots survive this
+		slots = array_slots(2 * len, slots, len);
+		juGC_store(obj->mems + 1, slots);
+	}
+
+	juGC_store(slots->mems + len, val);
+	obj->mems[0] = ju_from_int(len + 1);
+}
+
+// IntArray and RealArray are { length } followed by the raw numbers,
+//  which are left for the caller to fill in
+juc ju_make_ints (ju_int len)
+{
+	ju_obj* obj = ju_alloc(JU_TAG_INTS, len * sizeof(ju_int), 1);
+	obj->mems[0] = ju_from_int(len);
+	return (juc) obj;
+}
+juc ju_make_reals (ju_int len)
+{
+	ju_obj* obj = ju_alloc(JU_TAG_REALS, len * sizeof(ju_real), 1);
+	obj->mems[0] = ju_from_int(len);
+	return (juc) obj;
+}
+
+// a hash map is { count, used, keys, vals, hashes }, see jumap.c
+juc ju_make_map (ju_int cap)
+{
+	juc keys, vals, hashes;
+
+	juGC_root(&keys);
+	juGC_root(&vals);
+	juGC_root(&hashes);
+	keys = ju_make_array(cap, ju_null);
+	vals = ju_make_array(cap, ju_null);
+	hashes = ju_make_ints(cap);
+	memset(ju_get_buffer(hashes), 0, cap * sizeof(ju_int));
+
+	juc res = ju_make(JU_TAG_MAP, 5,
+		ju_from_int(0), ju_from_int(0), keys, vals, hashes);
+	juGC_unroot(3);
+
+	return res;
+}
+
 juc ju_make_box (juc val)
 {
-	return ju_make_buf(JU_TAG_BOX, 0, 1, val);
+	ju_obj* obj = ju_alloc(JU_TAG_BOX, 0, 1);
+	obj->mems[0] = val;
+	return (juc) obj;
 }
 
 juc ju_make_real (ju_real r)
 {
-	juc obj = ju_make_buf(JU_TAG_REAL, sizeof(ju_real), 0);
+	juc obj = ju_alloc(JU_TAG_REAL, sizeof(ju_real), 0);
 	*((ju_real*) ju_get_buffer(obj)) = r;
 	return obj;
 }
@@ -142,12 +353,45 @@ juc ju_make_real (ju_real r)
 juc ju_closure (ju_fnp fn, ju_int nmems, ...)
 {
 	va_list vl;
-	juc obj;
+	ju_obj* obj = ju_alloc_closure(fn, nmems);
 
 	va_start(vl, nmems);
-	obj = ju_vmake(JU_TAG_CLOSURE, sizeof(ju_fnp), nmems, vl);
+	ju_int i;
+	for (i = 0; i < nmems; i++)
+		obj->mems[i] = va_arg(vl, juc);
 	va_end(vl);
 
+	return (juc) obj;
+}
+
+
+
+
+
+
+// objects in a function's frame, set up by the compiled code
+//  which then stores the members itself
+juc ju_stack_buf (void* buf, ju_int tag, ju_int nmems)
+{
+	ju_obj* obj = buf;
+
+	obj->nmems = nmems;
+	obj->tag = tag;
+	juGC_init_stack(obj);
+
+	return (juc) obj;
+}
+
+juc ju_stack_box (void* buf, juc val)
+{
+	ju_obj* obj = ju_stack_buf(buf, JU_TAG_BOX, 1);
+	obj->mems[0] = val;
+	return (juc) obj;
+}
+
+juc ju_stack_closure (void* buf, ju_fnp fn, ju_int nmems)
+{
+	juc obj = ju_stack_buf(buf, JU_TAG_CLOSURE, nmems);
 	*((ju_fnp*) ju_get_buffer(obj)) = fn;
 	return obj;
 }
@@ -174,6 +418,7 @@ juc ju_safe_get (juc cell, char* tagname, ju_int tag, ju_int i)
 {
 	if (ju_get_tag(cell) != tag)
 	{
+		juStd_flush();
 		fprintf(stderr, "RUNTIME ERROR: expected object tag \"%s\"\n", tagname);
 		exit(1);
 	}
@@ -195,6 +440,7 @@ void ju_safe_put (juc cell, char* tagname, ju_int tag, ju_int i, juc val)
 {
 	if (ju_get_tag(cell) != tag)
 	{
+		juStd_flush();
 		fprintf(stderr, "RUNTIME: expected object tag \"%s\"\n", tagname);
 		exit(1);
 	}
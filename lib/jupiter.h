@@ -36,6 +36,7 @@ typedef struct ju_obj {
 
 void   ju_init ();
 void   ju_destroy ();
+juc    juStd_flush ();
 
 void   juGC_init ();
 void   juGC_destroy ();
@@ -44,6 +45,7 @@ void   juGC_begin ();
 void   juGC_step ();
 void   juGC_end ();
 void   juGC_init_obj (ju_obj* obj);
+void   juGC_init_stack (ju_obj* obj);
 void   juGC_root (juc* root);
 void   juGC_unroot (int n);
 void   juGC_store (juc* root, juc value);
@@ -58,12 +60,23 @@ bool   ju_to_bool (juc cell);
 juc    ju_from_int (ju_int i);
 juc    ju_from_bool (bool b);
 
+juc    ju_alloc (ju_int tag, ju_int aug, ju_int nmems);
+juc    ju_alloc_closure (ju_fnp fn, ju_int nmems);
 juc    ju_make_buf (ju_int tag, size_t aug, ju_int nmems, ...);
 #define ju_make(tag, ...) ju_make_buf(tag, 0, __VA_ARGS__)
 juc    ju_make_box (juc val);
 juc    ju_make_str (const char* buf, size_t size);
+juc    ju_concat_str (juc a, juc b);
 juc    ju_make_real (ju_real r);
+juc    ju_make_array (ju_int len, juc fill);
+juc    ju_make_ints (ju_int len);
+juc    ju_make_reals (ju_int len);
+juc    ju_make_map (ju_int cap);
+size_t ju_format_real (char* buf, ju_real r);
 juc    ju_closure (ju_fnp fn, ju_int nmems, ...);
+juc    ju_stack_buf (void* buf, ju_int tag, ju_int nmems);
+juc    ju_stack_box (void* buf, juc val);
+juc    ju_stack_closure (void* buf, ju_fnp fn, ju_int nmems);
 
 juc    ju_get (juc obj, ju_int i);
 juc    ju_safe_get (juc obj, char* tagname, ju_int tag, ju_int i);
@@ -71,6 +84,24 @@ char*  ju_get_buffer (juc obj);
 size_t ju_get_length (juc obj);
 ju_fnp ju_get_fn (juc obj);
 ju_real ju_get_real (juc obj);
+juc*   ju_array_data (juc arr);
 
 void   ju_put (juc obj, ju_int i, juc val);
-void   ju_safe_put (juc obj, char* tagname, ju_int tag, ju_int i, juc val);
\ No newline at end of file
+void   ju_array_push (juc arr, juc val);
+void   ju_safe_put (juc obj, char* tagname, ju_int tag, ju_int i, juc val);
+
+// vector kernels over unboxed numbers (see junum.c)
+ju_int  ju_sum_ints (const ju_int* a, size_t n);
+ju_int  ju_dot_ints (const ju_int* a, const ju_int* b, size_t n);
+void    ju_fill_ints (ju_int* out, ju_int x, size_t n);
+void    ju_scale_ints (ju_int* out, const ju_int* a, ju_int x, size_t n);
+void    ju_add_ints (ju_int* out, const ju_int* a, const ju_int* b, size_t n);
+void    ju_sub_ints (ju_int* out, const ju_int* a, const ju_int* b, size_t n);
+void    ju_mul_ints (ju_int* out, const ju_int* a, const ju_int* b, size_t n);
+ju_real ju_sum_reals (const ju_real* a, size_t n);
+ju_real ju_dot_reals (const ju_real* a, const ju_real* b, size_t n);
+void    ju_fill_reals (ju_real* out, ju_real x, size_t n);
+void    ju_scale_reals (ju_real* out, const ju_real* a, ju_real x, size_t n);
+void    ju_add_reals (ju_real* out, const ju_real* a, const ju_real* b, size_t n);
+void    ju_sub_reals (ju_real* out, const ju_real* a, const ju_real* b, size_t n);
+void    ju_mul_reals (ju_real* out, const ju_real* a, const ju_real* b, size_t n);
\ No newline at end of file
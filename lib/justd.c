@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #define die_unimpl(s) \
+	juStd_flush(), \
 	fprintf(stderr, "RUNTIME ERROR: unimplemented: \"" s "\"\n"), \
 	exit(-1), ju_null
 
@@ -120,61 +121,103 @@ juc juStd_mulBool (juc a, juc b)
 
 
 //////////////////////////////// print ////////////////////////////////
-juc juStd_println ()
+// output is collected here, and written out once the buffer is
+//  full, on flush() and when the program ends. with JU_LINEBUF
+//  set in the environment every line is written out right away
+#define OUT_BUF_SIZE 8192
+static char out_buf[OUT_BUF_SIZE];
+static size_t out_len = 0;
+static int out_linebuf = -1;
+
+juc juStd_flush ()
 {
-	putchar('\n');
+	fwrite(out_buf, 1, out_len, stdout);
 	fflush(stdout);
+	out_len = 0;
 
 	return ju_unit;
 }
-juc juStd_printStr (juc a)
+static void out_write (const char* buf, size_t len)
 {
-	fwrite(ju_get_buffer(a),
-			1,
-			ju_get_length(a),
-			stdout);
+	if (out_len + len > OUT_BUF_SIZE)
+	{
+		juStd_flush();
+
+		// not worth copying
+		if (len > OUT_BUF_SIZE)
+		{
+			fwrite(buf, 1, len, stdout);
+			return;
+		}
+	}
+
+	memcpy(out_buf + out_len, buf, len);
+	out_len += len;
+}
 
-	return ju_unit;
+#define INT_BUF_SIZE 16
+// puts the digits right before 'end', returns where they start
+static char* int_to_buf (char* end, ju_int a)
+{
+	// count down, so the most negative number works too
+	ju_int n = (a < 0) ? a : -a;
+
+	do
+	{
+		*--end = '0' - (n % 10);
+		n /= 10;
+	} while (n != 0);
+
+	if (a < 0)
+		*--end = '-';
+
+	return end;
 }
-juc juStd_printInt (juc ca)
+
+juc juStd_println ()
 {
-	printf("%d", ju_to_int(ca));
+	out_write("\n", 1);
+
+	if (out_linebuf < 0)
+		out_linebuf = (getenv("JU_LINEBUF") != NULL);
+	if (out_linebuf)
+		juStd_flush();
 
 	return ju_unit;
 }
-
-#define REAL_BUF_SIZE 32
-static size_t real_to_buf (char* buf, juc a)
+juc juStd_printStr (juc a)
 {
-	size_t len;
+	out_write(ju_get_buffer(a), ju_get_length(a));
 
-	// using sprintf() to handle doubles
-	sprintf(buf, "%.8f", ju_get_real(a));
-	len = strlen(buf);
+	return ju_unit;
+}
+juc juStd_printInt (juc ca)
+{
+	char buf[INT_BUF_SIZE];
+	char* str = int_to_buf(buf + INT_BUF_SIZE, ju_to_int(ca));
 
-	// trim excess zeroes
-	while (buf[len - 1] == '0')
-		len--;
-	if (buf[len - 1] == '.')
-		len++;
+	out_write(str, buf + INT_BUF_SIZE - str);
 
-	return len;
+	return ju_unit;
 }
+
+// shortest form that reads back the same (see judtoa.c)
+#define REAL_BUF_SIZE 32
 juc juStd_printReal (juc ca)
 {
 	char buf[REAL_BUF_SIZE];
-	size_t len = real_to_buf(buf, ca);
+	size_t len = ju_format_real(buf, ju_get_real(ca));
 
-	fwrite(buf, 1, len, stdout);
+	out_write(buf, len);
 
 	return ju_unit;
 }
 juc juStd_printBool (juc cell)
 {
 	if (cell == ju_false)
-		printf("false");
+		out_write("false", 5);
 	else
-		printf("true");
+		out_write("true", 4);
 
 	return ju_unit;
 }
@@ -184,18 +227,10 @@ juc juStd_printBool (juc cell)
 //////////////////////////////// Str ////////////////////////////////
 juc juStd_strInt (juc ca)
 {
-	const size_t BUF_SIZE = 16;
-	char buf[BUF_SIZE];
+	char buf[INT_BUF_SIZE];
+	char* str = int_to_buf(buf + INT_BUF_SIZE, ju_to_int(ca));
 
-	ju_int a = ju_to_int(ca);
-	size_t len = 0;
-	do
-	{
-		buf[BUF_SIZE - (++len)] = '0' + (a % 10);
-		a /= 10;
-	} while (a > 0);
-
-	return ju_make_str(buf + BUF_SIZE - len, len);
+	return ju_make_str(str, buf + INT_BUF_SIZE - str);
 }
 juc juStd_strBool (juc ca)
 {
@@ -206,7 +241,7 @@ juc juStd_strBool (juc ca)
 juc juStd_strReal (juc ca)
 {
 	char buf[REAL_BUF_SIZE];
-	size_t len = real_to_buf(buf, ca);
+	size_t len = ju_format_real(buf, ju_get_real(ca));
 	return ju_make_str(buf, len);
 }
 juc juStd_lenStr (juc a)
@@ -215,22 +250,365 @@ juc juStd_lenStr (juc a)
 		ju_from_int((ju_int)
 			ju_get_length(a));
 }
+juc juStd_eqStr (juc a, juc b)
+{
+	size_t len = ju_get_length(a);
+
+	if (a == b)
+		return ju_true;
+	if (ju_get_length(b) != len)
+		return ju_false;
+
+	return to_bool(memcmp(ju_get_buffer(a), ju_get_buffer(b), len) == 0);
+}
 juc juStd_appStrStr (juc a, juc b)
 {
-	size_t la, lb;
-	char* ba, *bb, *buf;
-	juc res;
+	// builds a rope, so appending repeatedly doesn't copy
+	//  the whole string every time
+	return ju_concat_str(a, b);
+}
+
+
+
+//////////////////////////////// List ////////////////////////////////
+// hangs 'tl' onto the end of a cell that was just made, so map and
+//  filter can build their result front to back in a loop. only ever
+//  used on cells nothing else can see yet
+juc juStd_setTail (juc cell, juc tl)
+{
+	ju_put(cell, 1, tl);
+	return ju_null;
+}
+
+
+//////////////////////////////// Array ////////////////////////////////
+static ju_int array_index (juc arr, juc ci)
+{
+	ju_int i = ju_to_int(ci);
+	ju_int len = (ju_int) ju_get_length(arr);
+
+	if (i < 0 || i >= len)
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: array index %d out of bounds (length %d)\n",
+			i, len);
+		exit(1);
+	}
 
-	la = ju_get_length(a);
-	lb = ju_get_length(b);
-	ba = ju_get_buffer(a);
-	bb = ju_get_buffer(b);
+	return i;
+}
 
-	res = ju_make_str(NULL, la + lb);
-	buf = ju_get_buffer(res);
+juc juStd_newArray ()
+{
+	return ju_make_array(0, ju_null);
+}
+juc juStd_makeArray (juc n, juc fill)
+{
+	ju_int len = ju_to_int(n);
+	return ju_make_array(len < 0 ? 0 : len, fill);
+}
+juc juStd_lenArray (juc arr)
+{
+	return ju_from_int((ju_int) ju_get_length(arr));
+}
+juc juStd_getArray (juc arr, juc ci)
+{
+	return ju_array_data(arr)[array_index(arr, ci)];
+}
+juc juStd_setArray (juc arr, juc ci, juc val)
+{
+	juGC_store(ju_array_data(arr) + array_index(arr, ci), val);
+	return ju_unit;
+}
+juc juStd_pushArray (juc arr, juc val)
+{
+	ju_array_push(arr, val);
+	return ju_unit;
+}
+juc juStd_popArray (juc arr)
+{
+	ju_int i = (ju_int) ju_get_length(arr) - 1;
+	juc* data = ju_array_data(arr);
+
+	if (i < 0)
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: pop from empty array\n");
+		exit(1);
+	}
 
-	memcpy(buf, ba, la);
-	memcpy(buf + la, bb, lb);
+	juc res = data[i];
 
+	// let go of the element, it may be the only thing keeping it alive
+	data[i] = ju_null;
+	ju_put(arr, 0, ju_from_int(i));
+	return res;
+}
+// a view has to lie inside the array when it is made
+juc juStd_checkView (juc arr, juc cfrom, juc cto)
+{
+	ju_int from = ju_to_int(cfrom), to = ju_to_int(cto);
+	ju_int len = (ju_int) ju_get_length(arr);
+
+	if (from < 0 || from > to || to > len)
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: view %d..%d out of bounds (length %d)\n",
+			from, to, len);
+		exit(1);
+	}
+
+	return ju_unit;
+}
+
+
+
+//////////////////////////////// IntArray / RealArray ////////////////////////////////
+// the numbers are stored raw, bulk operations use the kernels in junum.c
+#define ints(c)  ((ju_int*) ju_get_buffer(c))
+#define reals(c) ((ju_real*) ju_get_buffer(c))
+
+static size_t same_length (juc a, juc b)
+{
+	size_t len = ju_get_length(a);
+
+	if (ju_get_length(b) != len)
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: arrays of different lengths (%d and %d)\n",
+			(ju_int) len, (ju_int) ju_get_length(b));
+		exit(1);
+	}
+
+	return len;
+}
+
+juc juStd_makeIntArray (juc n, juc x)
+{
+	ju_int len = ju_to_int(n);
+	juc res = ju_make_ints(len < 0 ? 0 : len);
+	ju_fill_ints(ints(res), ju_to_int(x), ju_get_length(res));
 	return res;
 }
+juc juStd_getIntArray (juc arr, juc ci)
+{
+	return ju_from_int(ints(arr)[array_index(arr, ci)]);
+}
+juc juStd_setIntArray (juc arr, juc ci, juc x)
+{
+	ints(arr)[array_index(arr, ci)] = ju_to_int(x);
+	return ju_unit;
+}
+juc juStd_sumIntArray (juc arr)
+{
+	return ju_from_int(ju_sum_ints(ints(arr), ju_get_length(arr)));
+}
+juc juStd_dotIntArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	return ju_from_int(ju_dot_ints(ints(a), ints(b), len));
+}
+juc juStd_fillIntArray (juc arr, juc x)
+{
+	ju_fill_ints(ints(arr), ju_to_int(x), ju_get_length(arr));
+	return ju_unit;
+}
+juc juStd_copyIntArray (juc arr)
+{
+	size_t len = ju_get_length(arr);
+	juc res = ju_make_ints((ju_int) len);
+	memcpy(ints(res), ints(arr), len * sizeof(ju_int));
+	return res;
+}
+juc juStd_scaleIntArray (juc arr, juc x)
+{
+	size_t len = ju_get_length(arr);
+	juc res = ju_make_ints((ju_int) len);
+	ju_scale_ints(ints(res), ints(arr), ju_to_int(x), len);
+	return res;
+}
+juc juStd_addIntArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_ints((ju_int) len);
+	ju_add_ints(ints(res), ints(a), ints(b), len);
+	return res;
+}
+juc juStd_subIntArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_ints((ju_int) len);
+	ju_sub_ints(ints(res), ints(a), ints(b), len);
+	return res;
+}
+juc juStd_mulIntArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_ints((ju_int) len);
+	ju_mul_ints(ints(res), ints(a), ints(b), len);
+	return res;
+}
+
+juc juStd_makeRealArray (juc n, juc x)
+{
+	ju_int len = ju_to_int(n);
+	juc res = ju_make_reals(len < 0 ? 0 : len);
+	ju_fill_reals(reals(res), ju_get_real(x), ju_get_length(res));
+	return res;
+}
+juc juStd_getRealArray (juc arr, juc ci)
+{
+	return ju_make_real(reals(arr)[array_index(arr, ci)]);
+}
+juc juStd_setRealArray (juc arr, juc ci, juc x)
+{
+	reals(arr)[array_index(arr, ci)] = ju_get_real(x);
+	return ju_unit;
+}
+juc juStd_sumRealArray (juc arr)
+{
+	return ju_make_real(ju_sum_reals(reals(arr), ju_get_length(arr)));
+}
+juc juStd_dotRealArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	return ju_make_real(ju_dot_reals(reals(a), reals(b), len));
+}
+juc juStd_fillRealArray (juc arr, juc x)
+{
+	ju_fill_reals(reals(arr), ju_get_real(x), ju_get_length(arr));
+	return ju_unit;
+}
+juc juStd_copyRealArray (juc arr)
+{
+	size_t len = ju_get_length(arr);
+	juc res = ju_make_reals((ju_int) len);
+	memcpy(reals(res), reals(arr), len * sizeof(ju_real));
+	return res;
+}
+juc juStd_scaleRealArray (juc arr, juc x)
+{
+	size_t len = ju_get_length(arr);
+	juc res = ju_make_reals((ju_int) len);
+	ju_scale_reals(reals(res), reals(arr), ju_get_real(x), len);
+	return res;
+}
+juc juStd_addRealArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_reals((ju_int) len);
+	ju_add_reals(reals(res), reals(a), reals(b), len);
+	return res;
+}
+juc juStd_subRealArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_reals((ju_int) len);
+	ju_sub_reals(reals(res), reals(a), reals(b), len);
+	return res;
+}
+juc juStd_mulRealArray (juc a, juc b)
+{
+	size_t len = same_length(a, b);
+	juc res = ju_make_reals((ju_int) len);
+	ju_mul_reals(reals(res), reals(a), reals(b), len);
+	return res;
+}
+
+
+
+//////////////////////////////// Lines ////////////////////////////////
+// reads a file one line at a time: { next line } with the FILE* in
+//  the buffer. the next line is read ahead, so the end is known
+//  before anyone asks for it, and the file is closed once it's reached
+#define JU_TAG_LINES 0x13
+#define file_of(r) (*(FILE**) ju_get_buffer(r))
+
+static void read_line (juc r)
+{
+	FILE* fp = file_of(r);
+	char small[256];
+	char* buf = small;
+	size_t len = 0, cap = sizeof(small);
+	int done = 0;
+
+	while (!done && fgets(buf + len, (int) (cap - len), fp) != NULL)
+	{
+		len += strlen(buf + len);
+
+		if (len > 0 && buf[len - 1] == '\n')
+			done = 1;
+		else if (len + 1 == cap)
+		{
+			char* bigger = malloc(cap * 2);
+			memcpy(bigger, buf, len);
+			if (buf != small)
+				free(buf);
+			buf = bigger;
+			cap *= 2;
+		}
+	}
+
+	if (!done && len == 0)
+	{
+		fclose(fp);
+		file_of(r) = NULL;
+		ju_put(r, 0, ju_null);
+	}
+	else
+	{
+		if (len > 0 && buf[len - 1] == '\n')
+			len--;
+		if (len > 0 && buf[len - 1] == '\r')
+			len--;
+		ju_put(r, 0, ju_make_str(buf, len));
+	}
+
+	if (buf != small)
+		free(buf);
+}
+
+juc juStd_openLines (juc path)
+{
+	size_t len = ju_get_length(path);
+	char* name = malloc(len + 1);
+	FILE* fp;
+	juc r;
+
+	memcpy(name, ju_get_buffer(path), len);
+	name[len] = '\0';
+
+	if ((fp = fopen(name, "r")) == NULL)
+	{
+		juStd_flush();
+		fprintf(stderr, "RUNTIME ERROR: cannot open file '%s'\n", name);
+		exit(1);
+	}
+	free(name);
+
+	juGC_root(&r);
+	r = ju_alloc(JU_TAG_LINES, sizeof(FILE*), 1);
+	((ju_obj*) r)->mems[0] = ju_null;
+	file_of(r) = fp;
+	read_line(r);
+	juGC_unroot(1);
+
+	return r;
+}
+juc juStd_moreLines (juc r)
+{
+	return to_bool(ju_get(r, 0) != ju_null);
+}
+juc juStd_readLine (juc r)
+{
+	juc line;
+
+	// reading ahead replaces it in 'r', so it needs a root of its own
+	juGC_root(&line);
+	line = ju_get(r, 0);
+	if (line != ju_null)
+		read_line(r);
+	juGC_unroot(1);
+
+	return line;
+}
@@ -35,14 +35,22 @@ struct Sig
 
 
 
+// data of a ^get on a constructor's field. the index comes
+//  first so get<int_t>() works the same as for any other ^get
+struct CtorField
+{
+	int_t index;
+	int_t tag;
+};
+
 enum ExpKind
 {
 	// KIND         //  DATA
 	eInvalid = 0,
 	eiMake,         //  string, int_t, type
-	eiGet,          //  int_t, type
+	eiGet,          //  int_t, type  (CtorField, string for constructors)
 	eiPut,          //  int_t
-	eiTag,          //  string
+	eiTag,          //  string, int_t
 	eiCall,         //  string, type
 	eiEnv,
 	eInt,           //  int_t
@@ -1,5 +1,6 @@
 #include "Build.h"
 #include "Desugar.h"
+#include "Parallel.h"
 #include <fstream>
 
 
@@ -52,6 +53,53 @@ static bool fileExists (const std::string& path)
 	else
 		return false;
 }
+static std::string readFile (const std::string& path)
+{
+	std::ifstream fs(path);
+	if (!fs.good())
+	{
+		std::ostringstream ss;
+		ss << "cannot open file '" << path << "'";
+		throw Span().die(ss.str());
+	}
+
+	std::ostringstream ss;
+	ss << fs.rdbuf();
+	return ss.str();
+}
+static std::vector<std::string> scanImports (const std::string& path,
+                                               const std::string& contents)
+{
+	// only looks at the imports at the top of the file; any that
+	//  come later are found by the parser and loaded afterwards
+	std::vector<std::string> res;
+
+	try
+	{
+		Lexer lex;
+		lex.openString(contents, path);
+
+		for (;;)
+		{
+			if (lex.current() == tPub)
+				lex.advance();
+			if (lex.current() != tImport)
+				break;
+
+			lex.advance();
+			if (lex.current() != tIdent && lex.current() != tString)
+				break;
+
+			res.push_back(lex.advance().str);
+		}
+	}
+	catch (Span::Error&)
+	{
+		// reported properly by the parser
+	}
+
+	return res;
+}
 
 
 
@@ -101,17 +149,16 @@ ModulePtr Build::loadModule (const std::string& name)
 	if (it != _modules.end())
 		return it->second;
 
-	auto fullpath = findPath(name);
-	if (fullpath.empty())
+	auto parsed = _parsed.find(name);
+	if (parsed == _parsed.end())
 	{
-		std::ostringstream ss;
-		ss << "could not locate module '" << name << "'";
-		throw Span().die(ss.str());
+		_parseModules(name);
+		parsed = _parsed.find(name);
 	}
 
-	Lexer lex;
-	lex.openFile(fullpath);
-	auto proto = Parse::parseToplevel(lex);
+	auto proto = std::move(parsed->second);
+	_parsed.erase(parsed);
+
 	auto module = std::make_shared<Module>(name, proto);
 	_modules[name] = module;
 
@@ -123,6 +170,58 @@ ModulePtr Build::loadModule (const std::string& name)
 
 	return module;
 }
+void Build::_parseModules (const std::string& root)
+{
+	std::vector<std::string> names, paths, contents;
+
+	// find every module reachable from 'root' by scanning
+	//  the imports at the top of each file
+	std::vector<std::string> queue { root };
+	std::set<std::string> seen;
+	while (!queue.empty())
+	{
+		auto name = queue.back();
+		queue.pop_back();
+
+		if (_modules.find(name) != _modules.end() ||
+				_parsed.find(name) != _parsed.end() ||
+				!seen.insert(name).second)
+			continue;
+
+		auto fullpath = findPath(name);
+		if (fullpath.empty())
+		{
+			// missing imports are reported once they are loaded
+			if (name != root)
+				continue;
+
+			std::ostringstream ss;
+			ss << "could not locate module '" << name << "'";
+			throw Span().die(ss.str());
+		}
+
+		names.push_back(name);
+		paths.push_back(fullpath);
+		contents.push_back(readFile(fullpath));
+
+		auto imports = scanImports(fullpath, contents.back());
+		queue.insert(queue.end(), imports.rbegin(), imports.rend());
+	}
+
+	// parse all of the files at once
+	auto nfiles = names.size();
+	std::vector<GlobProto> protos(nfiles);
+
+	parallelFor(nfiles, [&] (size_t i)
+	{
+		Lexer lex;
+		lex.openString(contents[i], paths[i]);
+		protos[i] = Parse::parseToplevel(lex);
+	});
+
+	for (size_t i = 0; i < nfiles; i++)
+		_parsed[names[i]] = std::move(protos[i]);
+}
 
 void Build::import (ModulePtr dest, ModulePtr src, int str)
 {
@@ -196,16 +295,25 @@ void Build::createEntryPoint (const std::string& moduleName)
 
 void Build::finishModuleLoad ()
 {
+	std::vector<ModulePtr> modules;
 	for (auto& pair : _modules)
-		pair.second->finishImport();
+		modules.push_back(pair.second);
+	if (_entry != nullptr)
+		modules.push_back(_entry);
 
-	for (auto& pair : _modules)
-		pair.second->desugarAll();
+	for (auto& mod : modules)
+		mod->finishImport();
 
-	if (_entry != nullptr)
+	// overload resolution needs every signature, but bodies are
+	//  only desugared when Overload::inst first needs them
+	std::vector<OverloadPtr> overloads;
+	for (auto& mod : modules)
+		mod->ownOverloads(overloads);
+
+	for (auto& ov : overloads)
 	{
-		_entry->finishImport();
-		_entry->desugarAll();
+		Desugar desu(ov->env);
+		desu.desugarSig(ov);
 	}
 }
 Compiler* Build::_getCompiler (ModulePtr mod)
@@ -280,6 +388,7 @@ void Build::compile (std::ostream& out)
 
 	// generate code for C 'main()'
 	entryCompiler->entryPoint(entryCUnit);
+	Compiler::markLive(entryCUnit);
 
 	// write the code to files/stdout
 	if (_compileMode == Build::Single)
@@ -305,7 +414,9 @@ void Build::_maybeLoadInfodata (ModulePtr module)
 
 Module::Module (const std::string& _name, const GlobProto& proto)
 	: name(_name), env(proto)
-{}
+{
+	env.isStdlib = (name == JUP_STDLIB);
+}
 
 std::string Module::outputPath (const std::string& buildFolder)
 {
@@ -352,12 +463,11 @@ void Module::finishImport ()
 
 	// TODO: check for a-equiv function declarations??
 }
-void Module::desugarAll ()
+void Module::ownOverloads (std::vector<OverloadPtr>& out)
 {
+	// skip imported overloads, they belong to their own module
 	for (auto& fn : env.functions)
 		for (auto& ov : fn->overloads)
-		{
-			Desugar desu(env);
-			desu.desugar(ov);
-		}
+			if (&ov->env == &env)
+				out.push_back(ov);
 }
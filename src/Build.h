@@ -17,7 +17,7 @@ struct Module
 		const GlobProto& proto);
 
 	void finishImport ();
-	void desugarAll ();
+	void ownOverloads (std::vector<OverloadPtr>& out);
 
 	std::string outputPath (const std::string& buildFolder);
 	std::string infodataPath (const std::string& buildFolder);
@@ -50,9 +50,11 @@ private:
 	std::string _buildFolder;
 	std::set<std::string> _paths;
 	std::map<std::string, ModulePtr> _modules;
+	std::map<std::string, GlobProto> _parsed;
 	std::vector<Compiler*> _compilers;
 	ModulePtr _entry;
 
+	void _parseModules (const std::string& root);
 	void _maybeLoadInfodata (ModulePtr mod);
 	Compiler* _getCompiler (ModulePtr mod);
 	void _output (ModulePtr mod, std::ostream& log);
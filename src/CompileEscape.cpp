@@ -0,0 +1,413 @@
+#include "Compiler.h"
+
+
+/*
+	escape analysis
+
+	every abstract object gets a number: first the arguments of the
+	 function, then its environment (for lambdas), then each site in
+	 the body that allocates (list literals, lambdas, boxes for 'let mut')
+
+	scanning an expression gives the set of objects its value may be,
+	 and records which objects may be stored inside which other objects.
+	an object escapes if it is returned, given to the runtime, or to a
+	 function that lets it escape, and everything stored inside an
+	 escaping object escapes as well
+
+	sites that never escape (and are not inside of a loop, where the
+	 same stack slot would be reused by the next iteration) are then
+	 allocated in the function's frame instead of on the heap
+*/
+
+namespace {
+struct Escape
+{
+	using Objs = std::set<int>;
+
+	CompileUnit* cunit;
+	int nparams;
+	std::map<ExpPtr, int> sites;
+	std::vector<ExpPtr> siteExps;
+	std::set<int> looped;
+	std::map<std::string, Objs> vars;
+	std::map<std::string, Objs> boxes;
+	std::map<std::string, ExpPtr> known;
+	std::map<int, Objs> contains;
+	Objs direct;
+	Objs returned;
+	Objs carried;
+	bool changed;
+
+	Escape (CompileUnit* cu);
+
+	void run ();
+	int site (ExpPtr e, bool loop);
+	void merge (Objs& to, const Objs& from);
+	void escape (const Objs& objs);
+	void store (int obj, const Objs& objs);
+	Objs scan (ExpPtr e, bool loop);
+	Objs scanCall (ExpPtr e, bool loop);
+	Objs closure (const Objs& from) const;
+};
+}
+
+// values of these types can never refer to another object
+static bool pointerFree (TyPtr ty)
+{
+	if (ty == nullptr || ty->kind != tyConcrete)
+		return false;
+
+	if (ty->name == "Tuple")
+		return ty->subtypes.nil();
+
+	return ty->name == "Int" || ty->name == "Bool" ||
+	       ty->name == "Real" || ty->name == "Str";
+}
+
+Escape::Escape (CompileUnit* cu)
+	: cunit(cu)
+{
+	nparams = int(cu->funcInst.signature->args.size()) + 1;
+}
+
+int Escape::site (ExpPtr e, bool loop)
+{
+	auto it = sites.find(e);
+	int id;
+
+	if (it == sites.end())
+	{
+		id = nparams + int(siteExps.size());
+		sites[e] = id;
+		siteExps.push_back(e);
+		changed = true;
+	}
+	else
+		id = it->second;
+
+	if (loop && looped.insert(id).second)
+		changed = true;
+	return id;
+}
+void Escape::merge (Objs& to, const Objs& from)
+{
+	for (auto o : from)
+		if (to.insert(o).second)
+			changed = true;
+}
+void Escape::escape (const Objs& objs)
+{
+	merge(direct, objs);
+}
+void Escape::store (int obj, const Objs& objs)
+{
+	merge(contains[obj], objs);
+}
+
+Escape::Objs Escape::scan (ExpPtr e, bool loop)
+{
+	switch (e->kind)
+	{
+	case eVar:
+		if (e->get<bool>())
+			return {};
+		return vars[e->getString()];
+
+	case eiEnv:
+		return { nparams - 1 };
+
+	case eLet:
+		{
+			auto name = e->getString();
+			auto init = e->subexps[0];
+			auto objs = scan(init, loop);
+
+			if (cunit->knownLambdas.find(init) != cunit->knownLambdas.end())
+				known[name] = init;
+
+			merge(vars[name], objs);
+
+			if (e->get<bool>())
+			{
+				// variables unpacked from an environment are already boxed
+				if (init->kind == eiGet && init->subexps[0]->kind == eiEnv)
+					merge(boxes[name], objs);
+				else if (cunit->captured.find(name) != cunit->captured.end())
+				{
+					auto box = site(e, loop);
+					store(box, objs);
+					merge(boxes[name], { box });
+				}
+			}
+			return {};
+		}
+
+	case eAssign:
+		{
+			auto name = e->subexps[0]->getString();
+			auto objs = scan(e->subexps[1], loop);
+
+			merge(vars[name], objs);
+			for (auto box : boxes[name])
+				store(box, objs);
+			return {};
+		}
+
+	case eLambda:
+		{
+			auto lam = site(e, loop);
+			auto it = cunit->special.find(e);
+			bool envEscapes = true;
+
+			if (it != cunit->special.end())
+			{
+				auto lcu = it->second;
+				lcu->analyzeEscapes();
+
+				if (lcu->escapeState == 2)
+					envEscapes = lcu->argEscapes.back() || lcu->argReturned.back();
+			}
+
+			for (size_t i = 1, len = e->subexps.size(); i < len; i++)
+			{
+				auto name = e->subexps[i]->getString();
+				store(lam, vars[name]);
+				store(lam, boxes[name]);
+
+				if (envEscapes)
+				{
+					escape(vars[name]);
+					escape(boxes[name]);
+				}
+			}
+			return { lam };
+		}
+
+	case eList:
+		{
+			auto list = site(e, loop);
+			for (auto e2 : e->subexps)
+				store(list, scan(e2, loop));
+			return { list };
+		}
+
+	case eCall:
+		return scanCall(e, loop);
+
+	case eiTag:
+		scan(e->subexps[0], loop);
+		return {};
+
+	case eiGet:
+		{
+			// whatever is inside of an object counts as the object
+			//  itself, unless it can't refer to anything
+			auto objs = scan(e->subexps[0], loop);
+			if (pointerFree(e->getType()))
+				return {};
+			return objs;
+		}
+
+	case eCond:
+		{
+			scan(e->subexps[0], loop);
+			auto objs = scan(e->subexps[1], loop);
+			auto objs2 = scan(e->subexps[2], loop);
+			objs.insert(objs2.begin(), objs2.end());
+			return objs;
+		}
+
+	case eBlock:
+		{
+			Objs objs;
+			for (auto e2 : e->subexps)
+				objs = scan(e2, loop);
+			return objs;
+		}
+
+	case eLoop:
+		for (auto e2 : e->subexps)
+			scan(e2, true);
+		return {};
+
+	default:
+		for (auto e2 : e->subexps)
+			escape(scan(e2, loop));
+		return {};
+	}
+}
+
+Escape::Objs Escape::scanCall (ExpPtr e, bool loop)
+{
+	auto fn = e->subexps[0];
+	CompileUnit* callee = nullptr;
+	TyPtr fnty = nullptr;
+	Objs res, fnObjs;
+
+	if (fn->kind == eVar && fn->get<bool>())
+		callee = cunit->special[fn];
+	else if (fn->kind == eLambda &&
+			cunit->knownLambdas.find(fn) != cunit->knownLambdas.end())
+	{
+		scan(fn, loop);
+		callee = cunit->special[fn];
+	}
+	else if (fn->kind == eVar && known.find(fn->getString()) != known.end())
+		callee = cunit->special[known[fn->getString()]];
+	else if (fn->kind == eVar)
+	{
+		// calling a closure doesn't let it escape, and the types of
+		//  the arguments are known when it was passed to us
+		for (auto& arg : cunit->funcInst.signature->args)
+			if (arg.first == fn->getString())
+				fnty = arg.second;
+		fnObjs = scan(fn, loop);
+	}
+	else if (fn->kind != eiCall && fn->kind != eiMake)
+		fnObjs = scan(fn, loop);
+
+	if (callee != nullptr && callee != cunit)
+	{
+		callee->analyzeEscapes();
+
+		// still being analyzed further up, so nothing is known yet
+		if (callee->escapeState != 2)
+			callee = nullptr;
+	}
+
+	// a tail call replaces this frame, so nothing passed along
+	//  (including the closure being called) can live in it
+	bool reuses = cunit->tailCalls.find(e) != cunit->tailCalls.end();
+	if (reuses)
+		merge(carried, fnObjs);
+
+	for (size_t i = 1, len = e->subexps.size(); i < len; i++)
+	{
+		auto objs = scan(e->subexps[i], loop);
+		auto k = i - 1;
+
+		if (reuses)
+			merge(carried, objs);
+
+		if (callee != nullptr)
+		{
+			if (callee->argEscapes[k])
+				escape(objs);
+			if (callee->argReturned[k])
+				res.insert(objs.begin(), objs.end());
+		}
+		else if (fnty != nullptr && fnty->kind == tyConcrete &&
+				fnty->name == "Fn" && k < fnty->subtypes.length() - 1)
+		{
+			auto tys = fnty->subtypes;
+			for (size_t j = 0; j < k; j++)
+				++tys;
+
+			if (!pointerFree(tys.head()))
+				escape(objs);
+		}
+		else
+			escape(objs);
+	}
+
+	return res;
+}
+
+Escape::Objs Escape::closure (const Objs& from) const
+{
+	Objs res(from);
+	std::vector<int> stack(from.begin(), from.end());
+
+	while (!stack.empty())
+	{
+		auto it = contains.find(stack.back());
+		stack.pop_back();
+
+		if (it != contains.end())
+			for (auto o : it->second)
+				if (res.insert(o).second)
+					stack.push_back(o);
+	}
+	return res;
+}
+
+void Escape::run ()
+{
+	auto& args = cunit->funcInst.signature->args;
+
+	for (size_t i = 0, len = args.size(); i < len; i++)
+		vars[args[i].first].insert(int(i));
+
+	// the sets only grow, so scan until nothing changes
+	do
+	{
+		changed = false;
+		returned = scan(cunit->body, false);
+	}
+	while (changed);
+
+	// objects made here can't outlive the function
+	for (auto o : returned)
+		if (o >= nparams - 1)
+			direct.insert(o);
+
+	// neither can anything stored into an object that was passed
+	//  in (such as a box in the environment)
+	for (int i = 0; i < nparams; i++)
+	{
+		auto it = contains.find(i);
+		if (it != contains.end())
+			direct.insert(it->second.begin(), it->second.end());
+	}
+
+	auto escaped = closure(direct);
+	auto reused = closure(carried);
+	auto retty = cunit->funcInst.returnType;
+
+	for (int i = 0; i < nparams; i++)
+	{
+		bool scalar = (i < nparams - 1) && pointerFree(args[i].second);
+
+		cunit->argEscapes[i] = !scalar && escaped.count(i) > 0;
+		cunit->argReturned[i] = !scalar && !pointerFree(retty) &&
+			returned.count(i) > 0;
+	}
+
+	cunit->stackObjs.clear();
+	for (size_t i = 0, len = siteExps.size(); i < len; i++)
+	{
+		int id = nparams + int(i);
+		if (escaped.count(id) == 0 && looped.count(id) == 0 &&
+				reused.count(id) == 0)
+			cunit->stackObjs.insert(siteExps[i]);
+	}
+}
+
+
+
+void CompileUnit::analyzeEscapes ()
+{
+	if (escapeState != 0)
+		return;
+
+	auto nparams = funcInst.signature->args.size() + 1;
+	escapeState = 1;
+
+	// recursive calls see the summary from the previous round,
+	//  starting from "nothing escapes"
+	argEscapes.assign(nparams, false);
+	argReturned.assign(nparams, false);
+
+	for (;;)
+	{
+		auto escapes = argEscapes;
+		auto returned = argReturned;
+
+		Escape(this).run();
+
+		if (escapes == argEscapes && returned == argReturned)
+			break;
+	}
+
+	escapeState = 2;
+}
@@ -0,0 +1,482 @@
+#include "Compiler.h"
+#include <algorithm>
+
+
+/*
+	loop fusion
+
+	a chain of the stdlib's list functions like
+
+	   xs.map(f).filter(g).foldl(z, h)
+
+	builds a whole list at every step just for the next step to
+	 walk it once and throw it away. after inference the instance
+	 behind every call is known, so chains of map and filter that
+	 end in map, filter or foldl are replaced with one loop over
+	 the first list:
+
+	   { let mut #f0 = xs; let mut #f1 = z;
+	     loop ^tag? cons #f0 {
+	       let #f2 = f(^get hd #f0);
+	       if g(#f2) { #f1 = h(#f1, #f2) };
+	       #f0 = ^get tl #f0
+	     };
+	     #f1 }
+
+	a map or filter at the end builds its result front to back,
+	 like the stdlib does. f, g and h are now called element by
+	 element rather than one step after the other, so a chain is
+	 only fused when that can't be told apart: each function is
+	 a lambda or global that assigns to nothing outside of itself,
+	 and only calls instances like that and runtime functions that
+	 just compute their result. the other arguments are constants
+	 or variables that never change
+*/
+
+namespace {
+struct Fusion
+{
+	struct Stage
+	{
+		std::string name;
+		ExpPtr call;
+		CompileUnit* callee;
+	};
+
+	CompileUnit* cunit;
+	std::set<std::string> mutables;
+	std::map<CompileUnit*, bool> pureUnits;
+	int_t tagCons, tagNil;
+	int nvars;
+
+	Fusion (CompileUnit* cu);
+
+	ExpPtr run (ExpPtr e);
+	bool stage (ExpPtr e, Stage& out);
+	bool fixed (ExpPtr arg) const;
+	bool pure (ExpPtr e, CompileUnit* unit,
+	             const std::set<std::string>& outside);
+	bool pureUnit (CompileUnit* unit);
+	bool pureFunction (ExpPtr arg);
+	ExpPtr fuse (std::vector<Stage>& chain, ExpPtr source);
+
+	std::string newVar (ExpPtr block, TyPtr ty, ExpPtr init, bool mut);
+	ExpPtr function (ExpPtr block, ExpPtr arg, TyPtr ty);
+	void append (ExpPtr block, ExpPtr val, TyPtr listTy,
+	               const std::string& res, const std::string& last);
+};
+}
+
+static ExpPtr localVar (const std::string& name, const Span& span)
+{
+	return Exp::make(eVar, name, bool(false), {}, span);
+}
+
+// 'x' in List(x), or null if that isn't known
+static TyPtr elemType (TyPtr ty)
+{
+	if (ty == nullptr || ty->kind != tyConcrete ||
+			ty->name != "List" || ty->subtypes.nil())
+		return nullptr;
+
+	return ty->subtypes.head();
+}
+
+// the stdlib's own declaration of the list type
+static const TypeDecl* stdlibList (const GlobEnv& env)
+{
+	if (env.isStdlib)
+		for (auto& tydecl : env.proto.types)
+			if (tydecl.name == "List")
+				return &tydecl;
+	return nullptr;
+}
+
+// position of a constructor in its declaration
+static int_t ctorIndex (const TypeDecl* tydecl, const std::string& ctor)
+{
+	for (size_t i = 0, len = tydecl->ctors.size(); i < len; i++)
+		if (tydecl->ctors[i].name == ctor)
+			return int_t(i);
+	return -1;
+}
+
+// runtime functions that do nothing but compute their result
+static const std::set<std::string> pureRuntime {
+	"juStd_succInt", "juStd_predInt", "juStd_addInt", "juStd_mulInt",
+	"juStd_divInt", "juStd_modInt", "juStd_negInt", "juStd_ltInt",
+	"juStd_eqInt", "juStd_intReal",
+	"juStd_succReal", "juStd_predReal", "juStd_addReal", "juStd_mulReal",
+	"juStd_divReal", "juStd_negReal", "juStd_recipReal", "juStd_ltReal",
+	"juStd_eqReal", "juStd_realInt",
+	"juStd_notBool", "juStd_addBool", "juStd_mulBool",
+	"juStd_strInt", "juStd_strBool", "juStd_strReal",
+	"juStd_lenStr", "juStd_eqStr", "juStd_appStrStr",
+	"juStd_hashInt", "juStd_hashBool", "juStd_hashReal", "juStd_hashStr",
+};
+
+
+Fusion::Fusion (CompileUnit* cu)
+	: cunit(cu), tagCons(-1), tagNil(-1), nvars(0)
+{
+	findMutable(cu->overload->body, mutables);
+}
+
+bool Fusion::pure (ExpPtr e, CompileUnit* unit,
+                     const std::set<std::string>& outside)
+{
+	switch (e->kind)
+	{
+	case eAssign:
+		if (outside.find(e->subexps[0]->getString()) != outside.end())
+			return false;
+		break;
+
+	case eiPut:
+		return false;
+
+	// making a closure does nothing, calling one is checked below
+	case eLambda:
+		return true;
+
+	case eCall:
+		{
+			auto fn = e->subexps[0];
+
+			if (fn->kind == eiCall)
+			{
+				if (pureRuntime.find(fn->getString()) == pureRuntime.end())
+					return false;
+			}
+			else if (fn->kind == eVar && fn->get<bool>())
+			{
+				auto it = unit->special.find(fn);
+				if (it == unit->special.end() || !pureUnit(it->second))
+					return false;
+			}
+			else if (fn->kind != eiMake)
+				// closures can be anything
+				return false;
+
+			for (size_t i = 1, len = e->subexps.size(); i < len; i++)
+				if (!pure(e->subexps[i], unit, outside))
+					return false;
+			return true;
+		}
+
+	default:
+		break;
+	}
+
+	for (auto e2 : e->subexps)
+		if (!pure(e2, unit, outside))
+			return false;
+	return true;
+}
+
+bool Fusion::pureUnit (CompileUnit* unit)
+{
+	auto it = pureUnits.find(unit);
+	if (it != pureUnits.end())
+		return it->second;
+
+	// a recursive call adds nothing that the rest of the body
+	//  doesn't already show
+	pureUnits[unit] = true;
+
+	auto body = unit->body != nullptr ? unit->body : unit->overload->body;
+	bool res = false;
+
+	if (body != nullptr)
+	{
+		// lambdas start by unpacking their environment, those are
+		//  the variables that belong to someone else
+		std::set<std::string> outside;
+
+		if (unit->overload->hasEnv && body->kind == eBlock)
+			for (auto e : body->subexps)
+				if (e->kind == eLet && e->subexps[0]->kind == eiGet &&
+						e->subexps[0]->subexps[0]->kind == eiEnv)
+					outside.insert(e->getString());
+
+		res = pure(body, unit, outside);
+	}
+
+	return pureUnits[unit] = res;
+}
+
+bool Fusion::pureFunction (ExpPtr arg)
+{
+	if (arg->kind != eLambda &&
+			(arg->kind != eVar || !arg->get<bool>()))
+		return false;
+
+	auto it = cunit->special.find(arg);
+	return it != cunit->special.end() && pureUnit(it->second);
+}
+
+bool Fusion::fixed (ExpPtr arg) const
+{
+	switch (arg->kind)
+	{
+	case eInt: case eReal: case eString: case eBool:
+		return true;
+
+	case eVar:
+		return arg->get<bool>() ||
+			mutables.find(arg->getString()) == mutables.end();
+
+	case eList:
+		for (auto e : arg->subexps)
+			if (!fixed(e))
+				return false;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool Fusion::stage (ExpPtr e, Stage& out)
+{
+	if (e->kind != eCall)
+		return false;
+
+	auto fn = e->subexps[0];
+	auto it = cunit->special.find(fn);
+
+	if (fn->kind != eVar || !fn->get<bool>() ||
+			it == cunit->special.end())
+		return false;
+
+	auto callee = it->second;
+	auto& name = callee->overload->name;
+	size_t nargs = (name == "foldl") ? 3 : 2;
+
+	// only the stdlib's own functions, on the stdlib's own lists
+	auto list = stdlibList(callee->overload->env);
+	auto& env = cunit->overload->env;
+
+	if ((name != "map" && name != "filter" && name != "foldl") ||
+			e->subexps.size() != nargs + 1 ||
+			list == nullptr ||
+			elemType(callee->funcInst.signature->args[0].second) == nullptr)
+		return false;
+
+	// a list type of our own would hide the stdlib's
+	for (auto& tydecl : env.proto.types)
+		if (!env.isStdlib && tydecl.name == "List")
+			return false;
+
+	// the type of each step's result is needed
+	if (name != "foldl" &&
+			elemType(callee->funcInst.returnType) == nullptr)
+		return false;
+
+	// the function comes last, a seed for foldl before it
+	for (size_t i = 2; i < nargs; i++)
+		if (!fixed(e->subexps[i]))
+			return false;
+	if (!pureFunction(e->subexps[nargs]))
+		return false;
+
+	tagCons = ctorIndex(list, "cons");
+	tagNil = ctorIndex(list, "nil");
+	out = { name, e, callee };
+	return true;
+}
+
+ExpPtr Fusion::run (ExpPtr e)
+{
+	// lambda bodies belong to their own instance
+	if (e->kind == eLambda)
+		return e;
+
+	// find the longest chain ending here
+	std::vector<Stage> chain;
+	Stage st;
+	auto source = e;
+
+	while (stage(source, st) &&
+			(chain.empty() || st.name != "foldl"))
+	{
+		chain.push_back(st);
+		source = st.call->subexps[1];
+	}
+
+	if (chain.size() > 1)
+		return fuse(chain, run(source));
+
+	ExpList subs;
+	bool changed = false;
+
+	subs.reserve(e->subexps.size());
+	for (auto e2 : e->subexps)
+	{
+		subs.push_back(run(e2));
+		changed = changed || subs.back() != e2;
+	}
+
+	if (!changed)
+		return e;
+
+	auto res = e->withSubexps(subs);
+
+	auto it = cunit->letTypes.find(e);
+	if (it != cunit->letTypes.end())
+		cunit->letTypes[res] = it->second;
+
+	return res;
+}
+
+std::string Fusion::newVar (ExpPtr block, TyPtr ty, ExpPtr init, bool mut)
+{
+	std::ostringstream ss;
+	ss << "#f" << (nvars++);
+
+	auto let = Exp::make(eLet, ty, ss.str(), { init }, init->span);
+	let->set<bool>(mut);
+	cunit->letTypes[let] = ty;
+
+	block->subexps.push_back(let);
+	return ss.str();
+}
+
+ExpPtr Fusion::function (ExpPtr block, ExpPtr arg, TyPtr ty)
+{
+	// a lambda that is only ever called needs no closure, see
+	//  CompileUnit::findKnownLambdas()
+	if (arg->kind == eLambda)
+		return localVar(newVar(block, ty, arg, false), arg->span);
+	else
+		return arg;
+}
+
+void Fusion::append (ExpPtr block, ExpPtr val, TyPtr listTy,
+                       const std::string& res, const std::string& last)
+{
+	auto span = val->span;
+	auto cell = newVar(block, listTy, Exp::make(eList, { val }, span), false);
+	auto setTail = Exp::make(eiCall, Ty::makeFn({ listTy, listTy, Ty::makeUnit() }),
+		"juStd_setTail", {}, span);
+
+	block->subexps.push_back(Exp::make(eCond, {
+		Exp::make(eiTag, std::string("nil"), tagNil,
+			{ localVar(last, span) }, span),
+		Exp::make(eAssign, { localVar(res, span), localVar(cell, span) }, span),
+		Exp::make(eCall, { setTail, localVar(last, span), localVar(cell, span) }, span)
+	}, span));
+	block->subexps.push_back(Exp::make(eAssign,
+		{ localVar(last, span), localVar(cell, span) }, span));
+}
+
+ExpPtr Fusion::fuse (std::vector<Stage>& chain, ExpPtr source)
+{
+	auto span = chain.front().call->span;
+	auto block = Exp::make(eBlock, {}, span);
+	auto body = Exp::make(eBlock, {}, span);
+	auto terminal = chain.front();
+
+	// walked from the first step to the last
+	std::reverse(chain.begin(), chain.end());
+
+	auto srcTy = chain.front().callee->funcInst.signature->args[0].second;
+	auto cursor = newVar(block, srcTy, source, true);
+
+	// the functions of each step, in the order they were written
+	std::vector<ExpPtr> fns;
+	for (auto& st : chain)
+	{
+		auto& args = st.callee->funcInst.signature->args;
+		size_t i = args.size() - 1;
+
+		fns.push_back(function(block, st.call->subexps[i + 1], args[i].second));
+	}
+
+	std::string res, last;
+	auto retTy = terminal.callee->funcInst.returnType;
+
+	if (terminal.name == "foldl")
+		res = newVar(block, retTy, terminal.call->subexps[2], true);
+	else
+	{
+		res = newVar(block, retTy, Exp::make(eList, {}, span), true);
+		last = newVar(block, retTy, Exp::make(eList, {}, span), true);
+	}
+
+	auto hd = Exp::make(eiGet, CtorField { 0, tagCons },
+		{ localVar(cursor, span) }, span);
+	hd->setType(elemType(srcTy));
+	hd->setString("cons");
+
+	auto x = newVar(body, elemType(srcTy), hd, false);
+	auto cur = body;
+	std::vector<ExpPtr> inner;
+
+	for (size_t i = 0, len = chain.size(); i < len; i++)
+	{
+		auto& st = chain[i];
+		bool end = (i + 1 == len);
+
+		if (st.name == "foldl")
+			cur->subexps.push_back(Exp::make(eAssign, {
+				localVar(res, span),
+				Exp::make(eCall, { fns[i], localVar(res, span), localVar(x, span) }, span)
+			}, span));
+		else if (st.name == "map")
+		{
+			auto y = Exp::make(eCall, { fns[i], localVar(x, span) }, span);
+
+			if (end)
+				append(cur, y, retTy, res, last);
+			else
+				x = newVar(cur, elemType(st.callee->funcInst.returnType), y, false);
+		}
+		else
+		{
+			// the rest of the steps only see what passes
+			auto then = Exp::make(eBlock, {}, span);
+
+			cur->subexps.push_back(Exp::make(eCond, {
+				Exp::make(eCall, { fns[i], localVar(x, span) }, span),
+				then,
+				Exp::make(eTuple, {}, span)
+			}, span));
+
+			if (end)
+				append(then, localVar(x, span), retTy, res, last);
+
+			inner.push_back(then);
+			cur = then;
+		}
+	}
+
+	// no else => unit, like the parser does it
+	for (auto then : inner)
+		then->subexps.push_back(Exp::make(eTuple, {}, span));
+
+	auto tl = Exp::make(eiGet, CtorField { 1, tagCons },
+		{ localVar(cursor, span) }, span);
+	tl->setType(srcTy);
+	tl->setString("cons");
+	body->subexps.push_back(Exp::make(eAssign, { localVar(cursor, span), tl }, span));
+
+	auto more = Exp::make(eiTag, std::string("cons"), tagCons,
+		{ localVar(cursor, span) }, span);
+	block->subexps.push_back(Exp::make(eLoop, { more, body }, span));
+	block->subexps.push_back(localVar(res, span));
+
+	// the instances are only needed if called elsewhere
+	for (auto& st : chain)
+		cunit->special.erase(st.call->subexps[0]);
+
+	return block;
+}
+
+
+
+void CompileUnit::fuseLoops ()
+{
+	Fusion fus(this);
+	body = fus.run(overload->body);
+}
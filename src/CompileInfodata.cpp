@@ -22,7 +22,8 @@
 void Compiler::outputInfodata (std::ostream& os)
 {
 	for (auto& cu : _units)
-		_serializeCUnit(cu);
+		if (cu->live)
+			_serializeCUnit(cu);
 
 	_ssInfodata << _nameId << std::endl;
 	os << _ssInfodata.str();
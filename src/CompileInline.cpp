@@ -0,0 +1,282 @@
+#include "Compiler.h"
+
+
+/*
+	inlining
+
+	after inference the instance behind every called global is
+	 known, so calls to small instances are replaced with a copy
+	 of their body:
+
+	   f(a, b)  =>  { let #i0 = a; let #i1 = b; <body of f> }
+
+	arguments that are constants, globals or variables that
+	 never change are put directly where the parameter was used.
+	 every variable the copy binds gets a new name, so nothing in
+	 the copy can shadow something of ours or the other way around
+
+	bodies are shared by every instance of an overload, so the
+	 tree is copied up to each call that is replaced instead of
+	 being changed in place. instances have their own calls
+	 inlined first, so the size limit is on the final body
+*/
+
+// largest body (in expressions) that gets inlined
+#define INLINE_BUDGET 16
+
+namespace {
+struct Inliner
+{
+	using Names = std::map<std::string, ExpPtr>;
+
+	CompileUnit* cunit;
+	std::set<std::string> mutables;
+	int nvars;
+
+	Inliner (CompileUnit* cu);
+
+	ExpPtr run (ExpPtr e);
+	ExpPtr inlineCall (ExpPtr call, CompileUnit* callee);
+	ExpPtr copy (ExpPtr e, CompileUnit* from, Names& names);
+	ExpPtr copyLeaf (ExpPtr e, CompileUnit* from, const Span& span);
+	std::string newName ();
+	bool direct (ExpPtr arg) const;
+};
+}
+
+// size of an expression, or more than the limit if
+//  it can't be inlined at all
+static int inlineSize (ExpPtr e, int limit)
+{
+	switch (e->kind)
+	{
+	case eInt: case eReal: case eString: case eBool:
+	case eVar: case eTuple: case eCall: case eCond:
+	case eBlock: case eLet: case eAssign: case eLoop:
+	case eList: case eiMake: case eiGet: case eiPut:
+	case eiTag: case eiCall:
+		break;
+
+	// lambdas are instances of their own, and use the environment
+	default:
+		return limit + 1;
+	}
+
+	int size = 1;
+	for (auto e2 : e->subexps)
+	{
+		size += inlineSize(e2, limit - size);
+		if (size > limit)
+			break;
+	}
+	return size;
+}
+
+// variables that can change while a copied body runs
+void findMutable (ExpPtr e, std::set<std::string>& out)
+{
+	if (e->kind == eAssign && e->subexps[0]->kind == eVar)
+		out.insert(e->subexps[0]->getString());
+	else if (e->kind == eLet && e->get<bool>())
+		out.insert(e->getString());
+
+	for (auto e2 : e->subexps)
+		findMutable(e2, out);
+}
+
+static bool canInline (CompileUnit* cunit, CompileUnit* callee)
+{
+	// the body isn't there yet when the call is (in)directly recursive
+	return callee != cunit &&
+	       !callee->baked &&
+	       !callee->overload->hasEnv &&
+	       callee->body != nullptr &&
+	       inlineSize(callee->body, INLINE_BUDGET) <= INLINE_BUDGET;
+}
+
+
+Inliner::Inliner (CompileUnit* cu)
+	: cunit(cu), nvars(0)
+{
+	findMutable(cu->body, mutables);
+}
+
+std::string Inliner::newName ()
+{
+	std::ostringstream ss;
+	ss << "#i" << (nvars++);
+	return ss.str();
+}
+
+bool Inliner::direct (ExpPtr arg) const
+{
+	switch (arg->kind)
+	{
+	case eInt:
+	case eBool:
+		return true;
+
+	case eVar:
+		return arg->get<bool>() ||
+			mutables.find(arg->getString()) == mutables.end();
+
+	default:
+		return false;
+	}
+}
+
+ExpPtr Inliner::run (ExpPtr e)
+{
+	// lambda bodies belong to their own instance
+	if (e->kind == eLambda)
+		return e;
+
+	ExpList subs;
+	bool changed = false;
+
+	subs.reserve(e->subexps.size());
+	for (auto e2 : e->subexps)
+	{
+		subs.push_back(run(e2));
+		changed = changed || subs.back() != e2;
+	}
+
+	auto res = e;
+	if (changed)
+	{
+		res = e->withSubexps(subs);
+
+		auto it = cunit->letTypes.find(e);
+		if (it != cunit->letTypes.end())
+			cunit->letTypes[res] = it->second;
+	}
+
+	if (res->kind == eCall)
+	{
+		auto fn = res->subexps[0];
+		auto it = cunit->special.find(fn);
+
+		if (fn->kind == eVar && fn->get<bool>() &&
+				it != cunit->special.end() &&
+				canInline(cunit, it->second))
+		{
+			auto callee = it->second;
+
+			// the instance is only needed if called elsewhere
+			cunit->special.erase(it);
+			return inlineCall(res, callee);
+		}
+	}
+
+	return res;
+}
+
+ExpPtr Inliner::inlineCall (ExpPtr call, CompileUnit* callee)
+{
+	auto& params = callee->funcInst.signature->args;
+	auto block = Exp::make(eBlock, {}, call->span);
+	std::set<std::string> calleeMutables;
+	Names names;
+
+	findMutable(callee->body, calleeMutables);
+
+	for (size_t i = 0, len = params.size(); i < len; i++)
+	{
+		auto arg = call->subexps[i + 1];
+		auto& param = params[i].first;
+		auto mut = calleeMutables.find(param) != calleeMutables.end();
+
+		if (!mut && direct(arg))
+		{
+			names[param] = arg;
+			continue;
+		}
+
+		// evaluated once, in order, like the arguments of a call
+		auto name = newName();
+		auto let = Exp::make(eLet, params[i].second, name, { arg }, arg->span);
+		let->set<bool>(mut);
+		cunit->letTypes[let] = params[i].second;
+
+		block->subexps.push_back(let);
+		names[param] = Exp::make(eVar, name, bool(false), {}, arg->span);
+	}
+
+	auto body = copy(callee->body, callee, names);
+
+	if (block->subexps.empty())
+		return body;
+
+	block->subexps.push_back(body);
+	return block;
+}
+
+ExpPtr Inliner::copyLeaf (ExpPtr e, CompileUnit* from, const Span& span)
+{
+	auto res = e->withSpan(span);
+
+	auto it = from->special.find(e);
+	if (it != from->special.end())
+		cunit->special[res] = it->second;
+
+	return res;
+}
+
+ExpPtr Inliner::copy (ExpPtr e, CompileUnit* from, Names& names)
+{
+	switch (e->kind)
+	{
+	case eVar:
+		if (!e->get<bool>())
+		{
+			auto it = names.find(e->getString());
+			if (it != names.end())
+				return copyLeaf(it->second, cunit, e->span);
+		}
+		return copyLeaf(e, from, e->span);
+
+	case eLet:
+		{
+			// the initial value can't see the new variable
+			auto init = copy(e->subexps[0], from, names);
+			auto name = newName();
+			auto res = e->withSubexps({ init });
+
+			res->setString(name);
+			cunit->letTypes[res] = from->letTypes[e];
+			names[e->getString()] =
+				Exp::make(eVar, name, bool(false), {}, e->span);
+			return res;
+		}
+
+	case eBlock:
+		{
+			// variables go out of scope at the end of the block
+			Names inner(names);
+			ExpList subs;
+
+			subs.reserve(e->subexps.size());
+			for (auto e2 : e->subexps)
+				subs.push_back(copy(e2, from, inner));
+			return e->withSubexps(subs);
+		}
+
+	default:
+		{
+			ExpList subs;
+
+			subs.reserve(e->subexps.size());
+			for (auto e2 : e->subexps)
+				subs.push_back(copy(e2, from, names));
+			return e->withSubexps(subs);
+		}
+	}
+}
+
+
+
+void CompileUnit::inlineCalls ()
+{
+	Inliner inl(this);
+	body = inl.run(body);
+}
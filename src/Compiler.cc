@@ -1,3 +1,8 @@
 
 #define ENV_VAR   "%.env"
 #define JUP_CCONV "fastcc"
+
+// fields of %ju_obj (see 'ju_obj' in lib/jupiter.h), objects
+//  with members are { %ju_obj, [n x i8*] }
+#define OBJ_NMEMS "0"
+#define OBJ_TAG   "1"
@@ -1,4 +1,5 @@
 #include "Compiler.h"
+#include "Parallel.h"
 #include <sstream>
 #include <iomanip>
 #include <ctime>
@@ -41,6 +42,28 @@ static std::string escapeString (const std::string& str)
 	return ss.str();
 }
 
+static std::string objectType (size_t nmems, bool closure)
+{
+	std::ostringstream ss;
+	ss << "{ %ju_obj, [" << nmems << " x i8*]";
+	if (closure)
+		ss << ", i8*";
+	ss << " }";
+	return ss.str();
+}
+
+// values of these types are never pointers to objects, so
+//  variables holding them don't need to be gc roots
+static bool immediateType (TyPtr ty)
+{
+	if (ty == nullptr || ty->kind != tyConcrete)
+		return false;
+
+	if (ty->name == "Tuple")
+		return ty->subtypes.nil();
+
+	return ty->name == "Int" || ty->name == "Bool";
+}
 static std::string joinCommas (int n, const std::string& str)
 {
 	std::ostringstream ss;
@@ -147,15 +170,70 @@ void Compiler::entryPoint (CompileUnit* cunit)
 
 	_entry = cunit;
 }
+void Compiler::emit ()
+{
+	// every instance has been inferred by now, and generating the
+	//  code for each one only touches that instance
+	std::vector<CompileUnit*> pending;
+	for (auto cu : _units)
+		if (cu->pendingEmit && cu->live)
+			pending.push_back(cu);
+
+	// the analysis follows calls into other instances, so it
+	//  has to finish before any code is generated
+	for (auto cu : pending)
+		cu->analyzeEscapes();
+
+	parallelFor(pending.size(), [&] (size_t i)
+	{
+		pending[i]->emit();
+	});
+
+	// only declare what the live code uses, in a deterministic order
+	for (auto cu : pending)
+	{
+		for (auto& name : cu->externals)
+			addExternal(name);
+
+		for (auto& pair : cu->special)
+			if (pair.second->compiler != this &&
+					cu->switchTests.find(pair.first) == cu->switchTests.end())
+				addInclude(pair.second);
+	}
+}
+void Compiler::markLive (CompileUnit* root)
+{
+	// instances can be created while trying overloads that end up
+	//  unused, so only output what is reachable from the entry point
+	std::vector<CompileUnit*> stack { root };
+
+	while (!stack.empty())
+	{
+		auto cu = stack.back();
+		stack.pop_back();
+
+		if (cu->live)
+			continue;
+		cu->live = true;
+
+		// testers that are compiled into a switch are never called
+		for (auto& pair : cu->special)
+			if (cu->switchTests.find(pair.first) == cu->switchTests.end())
+				stack.push_back(pair.second);
+	}
+}
 void Compiler::output (std::ostream& os)
 {
+	emit();
+
 	if (_needsHeader)
 		outputRuntimeHeader(os);
 
 	os << _ssPrefix.str();
 
 	for (auto cu : _units)
-		cu->output(os);
+		if (cu->live)
+			cu->output(os);
 
 	if (_entry != nullptr)
 		outputEntryPoint(os);
@@ -190,10 +268,18 @@ CompileUnit::CompileUnit (Compiler* comp, OverloadPtr overload, SigPtr sig)
 	: compiler(comp),
 	  overload(overload),
 	  funcInst(this, sig),
+	  body(nullptr),
 	  finishedInfer(false),
+	  pendingEmit(false),
+	  live(false),
+	  baked(false),
+	  rootsArgs(false),
+	  flatEnv(-1),
 
 	  lifetime(0),
-	  nroots(0)
+	  nroots(0),
+	  nglobals(0),
+	  escapeState(0)
 {
 	internalName =
 		comp->genUniqueName(Compiler::mangle(overload->name));
@@ -207,8 +293,20 @@ CompileUnit::CompileUnit (Compiler* comp, OverloadPtr over,
 	  overload(over),
 	  internalName(intName),
 	  funcInst(this, sig, ret),
-	  finishedInfer(true)
-{}
+	  body(nullptr),
+	  finishedInfer(true),
+	  pendingEmit(false),
+	  live(true),
+	  baked(true),
+	  rootsArgs(false),
+	  flatEnv(-1),
+	  escapeState(2)
+{
+	// nothing is known about the body of an instance
+	//  compiled elsewhere
+	argEscapes.assign(sig->args.size() + 1, true);
+	argReturned.assign(sig->args.size() + 1, true);
+}
 
 
 void CompileUnit::output (std::ostream& out)
@@ -274,8 +372,9 @@ std::string CompileUnit::getTemp ()
 	else
 		tempLifetimes[i] = lifetime;
 
+	// ".t" followed by a number is taken by makeUnique(".t")
 	std::ostringstream ss;
-	ss << "%.t" << i;
+	ss << "%.tmp" << i;
 
 	if (i >= len)
 		stackAlloc(ss.str());
@@ -298,17 +397,37 @@ void CompileUnit::writePrefix (EnvPtr env)
 	         << "define " JUP_CCONV " i8* @"
 	         << internalName << " (";
 
-	auto nargs = env->vars.size() + (overload->hasEnv ? 1 : 0);
+	size_t nenv = 0;
+	if (overload->hasEnv)
+		nenv = (flatEnv >= 0 ? flatEnv : 1);
+
+	auto nargs = env->vars.size() + nenv;
 
 	for (size_t i = 0, len = env->vars.size(); i < nargs; i++)
 	{
 		if (i > 0)
 			ssPrefix << ", ";
 
-		ssPrefix << "i8* " << (i >= len ? ENV_VAR : env->vars[i].internal);
+		ssPrefix << "i8* ";
+		if (i < len)
+			ssPrefix << env->vars[i].internal;
+		else if (flatEnv >= 0)
+			ssPrefix << ENV_VAR << (i - len);
+		else
+			ssPrefix << ENV_VAR;
 	}
 
-	ssPrefix << ") unnamed_addr" << std::endl
+	// once inlined, a tail call is no longer in tail position
+	//  and would grow the stack again
+	bool jumps = false;
+	for (auto call : tailCalls)
+	{
+		auto it = special.find(call->subexps[0]);
+		if (it == special.end() || it->second != this)
+			jumps = true;
+	}
+
+	ssPrefix << ") unnamed_addr" << (jumps ? " noinline" : "") << std::endl
 	         << "{" << std::endl;
 }
 void CompileUnit::writeEnd ()
@@ -333,6 +452,136 @@ void CompileUnit::stackStore (const std::string& name,
 {
 	ssBody << "call void @juGC_store (i8** " << name << ", i8* " << value << ")" << std::endl;
 }
+std::string CompileUnit::stackObject (size_t nmems, bool closure)
+{
+	// space for an object in the function's frame, with the same
+	//  layout as 'ju_obj'. it still has to be set up with one of
+	//  the 'ju_stack_*' runtime functions where it is created
+	auto type = objectType(nmems, closure);
+	auto ptr = makeUnique(".so");
+	auto obj = makeUnique(".obj");
+
+	ssPrefix << obj << " = alloca " << type << std::endl
+	         << ptr << " = bitcast " << type << "* " << obj << " to i8*" << std::endl;
+
+	return ptr;
+}
+void CompileUnit::storeMembers (const std::string& ptr,
+                                  const std::vector<std::string>& vals,
+                                  bool closure)
+{
+	// fill in the members of an object that was just allocated,
+	//  nothing can be collected in between
+	if (vals.empty())
+		return;
+
+	auto type = objectType(vals.size(), closure);
+	auto obj = makeUnique(".obj");
+
+	ssBody << obj << " = bitcast i8* " << ptr << " to " << type << "*" << std::endl;
+
+	for (size_t i = 0, len = vals.size(); i < len; i++)
+	{
+		auto mem = makeUnique(".mem");
+		ssBody << mem << " = getelementptr inbounds " << type << "* " << obj
+		       << ", i32 0, i32 1, i32 " << i << std::endl
+		       << "store i8* " << vals[i] << ", i8** " << mem << std::endl;
+	}
+}
+std::string CompileUnit::memberAddr (const std::string& val, int_t i)
+{
+	auto obj = makeUnique(".obj");
+	auto mem = makeUnique(".mem");
+
+	ssBody << obj << " = bitcast i8* " << val << " to "
+	       << objectType(0, false) << "*" << std::endl
+	       << mem << " = getelementptr " << objectType(0, false) << "* " << obj
+	       << ", i32 0, i32 1, i32 " << i << std::endl;
+
+	return mem;
+}
+std::string CompileUnit::loadMember (const std::string& val, int_t i)
+{
+	auto mem = memberAddr(val, i);
+	auto res = makeUnique(".m");
+
+	ssBody << res << " = load i8** " << mem << std::endl;
+	return res;
+}
+std::string CompileUnit::isImmediate (const std::string& val)
+{
+	// ints and null aren't pointers to objects
+	auto bits = makeUnique(".bits");
+	auto low = makeUnique(".low");
+	auto isint = makeUnique(".isint");
+	auto isnull = makeUnique(".isnull");
+	auto res = makeUnique(".imm");
+
+	ssBody << bits << " = ptrtoint i8* " << val << " to i32" << std::endl
+	       << low << " = and i32 " << bits << ", 1" << std::endl
+	       << isint << " = icmp ne i32 " << low << ", 0" << std::endl
+	       << isnull << " = icmp eq i8* " << val << ", null" << std::endl
+	       << res << " = or i1 " << isint << ", " << isnull << std::endl;
+
+	return res;
+}
+std::string CompileUnit::loadTag (const std::string& val)
+{
+	/*
+		same as ju_get_tag: small objects are just their tag
+		 shifted like an int, anything else stores its tag
+	*/
+	auto res = makeUnique(".tag");
+	auto t1 = makeUnique(".t");
+	auto t2 = makeUnique(".t");
+	auto lint = makeUnique("Lint");
+	auto lobj = makeUnique("Lobj");
+	auto lend = makeUnique("Lend");
+	auto imm = isImmediate(val);
+
+	auto bits = makeUnique(".bits");
+	auto hdr = makeUnique(".hdr");
+	auto field = makeUnique(".f");
+
+	ssBody << "br i1 " << imm
+	       << ", label " << lint
+	       << ", label " << lobj << std::endl
+	       << std::endl
+	       << lint.substr(1) << ":" << std::endl
+	       << bits << " = ptrtoint i8* " << val << " to i32" << std::endl
+	       << t1 << " = ashr i32 " << bits << ", 1" << std::endl
+	       << "br label " << lend << std::endl
+	       << std::endl
+	       << lobj.substr(1) << ":" << std::endl
+	       << hdr << " = bitcast i8* " << val << " to %ju_obj*" << std::endl
+	       << field << " = getelementptr inbounds %ju_obj* " << hdr
+	       << ", i32 0, i32 " OBJ_TAG << std::endl
+	       << t2 << " = load i32* " << field << std::endl
+	       << "br label " << lend << std::endl
+	       << std::endl
+	       << lend.substr(1) << ":" << std::endl
+	       << res << " = phi i32 [ " << t1 << ", " << lint
+	       << " ], [ " << t2 << ", " << lobj << " ]" << std::endl;
+
+	return res;
+}
+std::string CompileUnit::makeObject (int_t tag, const std::vector<std::string>& vals)
+{
+	// very small objects are represented as just their tags
+	if (vals.empty())
+	{
+		std::ostringstream ss;
+		ss << "inttoptr (i32 " << (1 | (tag << 1)) << " to i8*)";
+		return ss.str();
+	}
+
+	auto res = makeUnique(".o");
+	ssBody << res << " = call i8* @ju_alloc (i32 " << tag
+	       << ", i32 0, i32 " << vals.size() << ")" << std::endl;
+
+	storeMembers(res, vals, false);
+	return res;
+}
 
 
 
@@ -345,11 +594,25 @@ void CompileUnit::findTailCalls (ExpPtr exp)
 	{
 	case eCall:
 		{
+			// every jupiter function is 'fastcc', which 'llc -tailcallopt'
+			//  always turns into a jump when marked 'tail'
 			auto fn = exp->subexps[0];
+
+			if (fn->kind == eiCall || fn->kind == eiMake || fn->kind == eLambda)
+				break;
+
+			// our roots are gone by the time the callee runs, so it
+			//  has to root its own arguments. instances compiled
+			//  elsewhere might not
 			auto it = special.find(fn);
+			if (it != special.end())
+			{
+				if (it->second->baked)
+					break;
+				it->second->rootsArgs = true;
+			}
 
-			if (it != special.end() && it->second == this)
-				tailCalls.insert(exp);
+			tailCalls.insert(exp);
 			break;
 		}
 
@@ -366,6 +629,37 @@ void CompileUnit::findTailCalls (ExpPtr exp)
 	default: break;
 	}
 }
+void CompileUnit::findSwitchTests (ExpPtr exp)
+{
+	int_t tag;
+
+	// compileCond uses a switch for each of these
+	if (exp->kind == eCond && exp->subexps[0]->kind == eCall &&
+			tagTest(exp->subexps[0], tag) != nullptr)
+		switchTests.insert(exp->subexps[0]->subexps[0]);
+
+	// lambda bodies belong to their own instance
+	if (exp->kind != eLambda)
+		for (auto& e : exp->subexps)
+			findSwitchTests(e);
+}
+void CompileUnit::findFuncValues (ExpPtr exp)
+{
+	// functions used as values may be tail called through a closure
+	if (exp->kind == eVar && exp->get<bool>())
+	{
+		auto it = special.find(exp);
+		if (it != special.end())
+			it->second->rootsArgs = true;
+	}
+
+	if (exp->kind == eLambda)
+		return;
+
+	for (size_t i = 0, len = exp->subexps.size(); i < len; i++)
+		if (exp->kind != eCall || i > 0 || exp->subexps[0]->kind != eVar)
+			findFuncValues(exp->subexps[i]);
+}
 bool CompileUnit::doesTailCall (ExpPtr exp) const
 {
 	switch (exp->kind)
@@ -383,6 +677,113 @@ bool CompileUnit::doesTailCall (ExpPtr exp) const
 	default: return false;
 	}
 }
+
+namespace {
+struct KnownCalls
+{
+	std::map<std::string, int> decls;
+	std::map<std::string, ExpPtr> lambdas;
+	std::set<std::string> escapes;
+	std::set<std::string> captured;
+	std::vector<ExpPtr> immediate;
+
+	void scan (ExpPtr exp);
+};
+}
+
+void KnownCalls::scan (ExpPtr exp)
+{
+	switch (exp->kind)
+	{
+	case eVar:
+		// any use other than calling it lets the value escape
+		if (!exp->get<bool>())
+			escapes.insert(exp->getString());
+		return;
+
+	case eLet:
+		decls[exp->getString()]++;
+		if (!exp->get<bool>() && exp->subexps[0]->kind == eLambda)
+			lambdas[exp->getString()] = exp->subexps[0];
+		break;
+
+	case eLambda:
+		// the body is compiled as its own function, so only
+		//  the captured variables are used here
+		for (size_t i = 1, len = exp->subexps.size(); i < len; i++)
+		{
+			captured.insert(exp->subexps[i]->getString());
+			scan(exp->subexps[i]);
+		}
+		return;
+
+	case eCall:
+		{
+			auto fn = exp->subexps[0];
+
+			if (fn->kind == eLambda)
+			{
+				immediate.push_back(fn);
+				scan(fn);
+			}
+			else if (!(fn->kind == eVar && !fn->get<bool>()))
+				scan(fn);
+
+			for (size_t i = 1, len = exp->subexps.size(); i < len; i++)
+				scan(exp->subexps[i]);
+			return;
+		}
+
+	default: break;
+	}
+
+	for (auto e2 : exp->subexps)
+		scan(e2);
+}
+
+void CompileUnit::findKnownLambdas ()
+{
+	// a lambda bound by 'let' that is only ever called (or a
+	//  lambda called right where it is written) never needs a
+	//  closure: call its function directly, and pass the captured
+	//  variables as extra arguments instead of through the closure
+	KnownCalls kc;
+
+	for (auto& arg : funcInst.signature->args)
+		kc.decls[arg.first]++;
+	kc.scan(body);
+
+	// only mutable variables that lambdas capture need a box
+	captured = kc.captured;
+
+	std::vector<ExpPtr> known(kc.immediate);
+	for (auto& pair : kc.lambdas)
+		if (kc.decls[pair.first] == 1 &&
+				kc.escapes.find(pair.first) == kc.escapes.end())
+			known.push_back(pair.second);
+
+	for (auto lam : known)
+	{
+		auto it = special.find(lam);
+		if (it == special.end())
+			continue;
+
+		knownLambdas.insert(lam);
+		it->second->flatEnv = int(lam->subexps.size() - 1);
+	}
+}
+ExpPtr CompileUnit::knownCallee (ExpPtr fn, EnvPtr env)
+{
+	if (fn->kind == eLambda)
+	{
+		if (knownLambdas.find(fn) != knownLambdas.end())
+			return fn;
+	}
+	else if (fn->kind == eVar && !fn->get<bool>())
+		return env->get(fn->getString()).lambda;
+
+	return nullptr;
+}
 bool CompileUnit::needsRetain (ExpPtr exp)
 {
 	switch (exp->kind)
@@ -413,6 +814,26 @@ void CompileUnit::compile ()
 	Infer inf(this, sig);
 	finishedInfer = true;
 
+	// chains of list functions become a single loop, and
+	//  small instances that are called are copied in
+	fuseLoops();
+	inlineCalls();
+
+	// decide how lambdas are called before any code is emitted
+	findKnownLambdas();
+	findTailCalls(body);
+	findSwitchTests(body);
+	findFuncValues(body);
+
+	// code is generated later by Compiler::emit()
+	pendingEmit = true;
+}
+void CompileUnit::emit ()
+{
+	pendingEmit = false;
+
+	auto& sig = funcInst.signature;
+
 	// create arguments
 	auto env = makeEnv();
 	for (size_t i = 0, len = sig->args.size(); i < len; i++)
@@ -427,29 +848,60 @@ void CompileUnit::compile ()
 
 	ssBody << std::endl;
 
-	// find tail calls beforehand
-	findTailCalls(overload->body);
-	auto res = compile(overload->body, env, false);
-
-	if (!tailCalls.empty())
+	bool loops = false;
+	for (auto call : tailCalls)
 	{
-		// root all of the arguments in the case of
-		//  a tail call
+		auto it = special.find(call->subexps[0]);
+		if (it != special.end() && it->second == this)
+			loops = true;
+	}
 
-		std::vector<std::string> tmps;
-		tmps.reserve(env->vars.size());
-		for (auto& v : env->vars)
+	// closures can always be tail called
+	if (overload->hasEnv && flatEnv < 0)
+		rootsArgs = true;
+
+	if (loops || rootsArgs)
+	{
+		// self tail calls jump back to the top, so the arguments
+		//  live in slots that can be overwritten. when tail called,
+		//  the caller's roots are gone so they need our own
+		for (size_t i = 0, len = env->vars.size(); i < len; i++)
 		{
-			auto tmp = makeUnique(v.name);
-			stackAlloc(tmp);
-			tmps.push_back(tmp);
+			auto& v = env->vars[i];
+			auto slot = makeUnique(Compiler::mangle(v.name));
+
+			v.scalar = immediateType(sig->args[i].second);
+			if (v.scalar && !loops)
+				;
+			else if (v.scalar)
+				ssPrefix << slot << " = alloca i8*" << std::endl
+				         << "store i8* " << v.internal << ", i8** " << slot << std::endl;
+			else
+			{
+				stackAlloc(slot);
+				ssPrefix << "call void @juGC_store (i8** " << slot
+				         << ", i8* " << v.internal << ")" << std::endl;
+			}
+
+			if (!v.scalar || loops)
+			{
+				v.internal = slot;
+				v.stackAlloc = true;
+			}
+			argVars.push_back(v);
 		}
+	}
 
-		for (size_t i = 0, len = env->vars.size(); i < len; i++)
-			ssPrefix << "call void @juGC_store (i8** " << tmps[i]
-			         << ", i8* " << env->vars[i].internal << ")" << std::endl;
+	if (loops)
+	{
+		labelTop = makeUnique("Ltop");
+		ssBody << "br label " << labelTop << std::endl
+		       << std::endl
+		       << labelTop.substr(1) << ":" << std::endl;
 	}
 
+	auto res = compile(body, env, false);
+
 	// create variable for number of gc roots on stack
 	if (nroots > 0 || !tailCalls.empty())
 	{
@@ -522,12 +974,13 @@ std::string CompileUnit::compile (ExpPtr e, EnvPtr env, bool retain)
 
 std::string CompileUnit::makeGlobalString (const std::string& str, bool nullterm)
 {
-	auto strConst = compiler->genUniqueName();
+	std::ostringstream strConst;
+	strConst << internalName << ".s" << (nglobals++);
 
 	std::ostringstream strType;
 	strType << "[" << (str.size() + (nullterm ? 1 : 0)) << " x i8]";
 
-	ssEnd << "@" << strConst
+	ssEnd << "@" << strConst.str()
 	      << " = private unnamed_addr constant "
 	      << strType.str() << " c\"" << escapeString(str);
 
@@ -537,7 +990,7 @@ std::string CompileUnit::makeGlobalString (const std::string& str, bool nullterm
 	ssEnd << "\"" << std::endl;
 
 	std::ostringstream ss;
-	ss << "getelementptr (" << strType.str() << "* @" << strConst
+	ss << "getelementptr (" << strType.str() << "* @" << strConst.str()
 	   << ", i32 0, i32 0)";
 	
 	return ss.str();
@@ -579,11 +1032,15 @@ std::string CompileUnit::compileVar (ExpPtr e, EnvPtr env)
 	{
 		auto val = makeUnique(".g");
 		auto cunit = special[e];
+		auto fn = "@" + cunit->internalName;
+
+		if (cunit->baked)
+			fn = rootWrapper(cunit);
 
-		ssBody << val << " = call i8* (i8*, i32, ...)* @ju_closure ("
+		ssBody << val << " = call i8* @ju_alloc_closure ("
 			   << "i8* bitcast (i8* ("
 			   << joinCommas(cunit->overload->signature->args.size(), "i8*")
-			   << ")* @" << cunit->internalName << " to i8*), i32 0)" << std::endl;
+			   << ")* " << fn << " to i8*), i32 0)" << std::endl;
 		
 		return val;
 	}
@@ -597,12 +1054,7 @@ std::string CompileUnit::compileVar (ExpPtr e, EnvPtr env)
 			ssBody << val << " = load i8** " << var.internal << std::endl;
 
 			if (var.mut)
-			{
-				auto unbox = makeUnique(".ub");
-				ssBody << unbox << " = call i8* @ju_get (i8* " << val << ", i32 0)" << std::endl;
-				
-				return unbox;
-			}
+				return loadMember(val, 0);
 			else
 				return val;
 		}
@@ -611,6 +1063,42 @@ std::string CompileUnit::compileVar (ExpPtr e, EnvPtr env)
 	}
 }
 
+std::string CompileUnit::rootWrapper (CompileUnit* cunit)
+{
+	/*
+		closures may be tail called, so their function has to root
+		 its own arguments. an instance compiled elsewhere might not,
+		 so it gets called through one that does
+	*/
+	auto it = rootWrappers.find(cunit);
+	if (it != rootWrappers.end())
+		return it->second;
+
+	auto name = "@" + internalName + makeUnique(".wrap").substr(1);
+	auto nargs = cunit->overload->signature->args.size();
+	std::ostringstream args;
+
+	ssEnd << std::endl
+	      << "define private " JUP_CCONV " i8* " << name << " ("
+	      << joinCommas(nargs, "i8*") << ") unnamed_addr" << std::endl
+	      << "{" << std::endl;
+
+	for (size_t i = 0; i < nargs; i++)
+	{
+		ssEnd << "%r" << i << " = alloca i8*" << std::endl
+		      << "call void @juGC_root (i8** %r" << i << ")" << std::endl
+		      << "call void @juGC_store (i8** %r" << i << ", i8* %" << i << ")" << std::endl;
+		args << (i > 0 ? ", " : "") << "i8* %" << i;
+	}
+
+	ssEnd << "%res = call " JUP_CCONV " i8* @" << cunit->internalName
+	      << " (" << args.str() << ")" << std::endl
+	      << "call void @juGC_unroot (i32 " << nargs << ")" << std::endl
+	      << "ret i8* %res" << std::endl
+	      << "}" << std::endl;
+
+	return rootWrappers[cunit] = name;
+}
 std::string CompileUnit::compileCall (ExpPtr e, EnvPtr env)
 {
 	std::ostringstream call;
@@ -619,6 +1107,14 @@ std::string CompileUnit::compileCall (ExpPtr e, EnvPtr env)
 
 	size_t nargs = e->subexps.size() - 1;
 	auto isTail = doesTailCall(e);
+	ExpPtr lambda;
+	std::string captures = "";
+
+	if (fn->kind == eiMake)
+		return compileMake(e, env);
+
+	if (isTail && fn->kind == eVar && fn->get<bool>() && special[fn] == this)
+		return compileSelfTail(e, env);
 
 	if (fn->kind == eVar && fn->get<bool>())
 	{
@@ -626,24 +1122,28 @@ std::string CompileUnit::compileCall (ExpPtr e, EnvPtr env)
 		auto cunit = special[fn];
 		call << "call " JUP_CCONV " i8* @" << cunit->internalName << " (";
 	}
-	else if (fn->kind == eiMake)
-	{
-		// ^make construct for manually creating runtime objects
-		auto tag = GlobEnv::getTag(fn->getString());
-
-		call << "call i8* (i32, i32, i32, ...)* @ju_make_buf (i32 "
-		     << tag << ", i32 0, i32 " << nargs;
-
-		if (nargs > 0)
-			call << ", ";
-	}
 	else if (fn->kind == eiCall)
 	{
 		// ^call construct for calling C runtime/stdlib functions
 		call << "call ccc i8* bitcast (i8* (...)* @" << fn->getString()
 			 << " to i8* (" << joinCommas(nargs, "i8*") << ")*) (";
 
-		compiler->addExternal(fn->getString());
+		externals.push_back(fn->getString());
+	}
+	else if ((lambda = knownCallee(fn, env)) != nullptr)
+	{
+		// lambda that never escapes, call it directly
+		auto cunit = special[lambda];
+		auto it = knownEnvs.find(lambda);
+		auto vars = (it != knownEnvs.end()) ? it->second : captureVars(lambda, env);
+
+		for (auto& val : compileCaptures(vars))
+			captures += ", i8* " + val;
+		call << "call " JUP_CCONV " i8* @" << cunit->internalName << " (";
+
+		// captured boxes may live in this frame
+		if (!vars.empty())
+			isTail = false;
 	}
 	else
 	{
@@ -672,6 +1172,9 @@ std::string CompileUnit::compileCall (ExpPtr e, EnvPtr env)
 	}
 	popLifetime();
 
+	if (!captures.empty())
+		call << (nargs > 0 ? captures : captures.substr(2));
+
 	if (!closure.empty())
 	{
 		if (nargs > 0)
@@ -697,11 +1200,72 @@ std::string CompileUnit::compileCall (ExpPtr e, EnvPtr env)
 	return res;
 }
 
+std::string CompileUnit::compileSelfTail (ExpPtr e, EnvPtr env)
+{
+	/*
+		f(a, b) in tail position of f itself
+		  =>
+		<a, b into the argument slots>
+		br <top of f>
+	*/
+	std::vector<std::string> vals;
+	vals.reserve(argVars.size());
+
+	// nothing allocates after the last argument, and ints don't
+	//  need to be kept alive
+	pushLifetime();
+	for (size_t i = 1, len = e->subexps.size(); i < len; i++)
+		vals.push_back(compile(e->subexps[i], env,
+			!argVars[i - 1].scalar && i < len - 1));
+
+	// every argument is evaluated before any slot is overwritten
+	for (size_t i = 0, len = vals.size(); i < len; i++)
+		if (argVars[i].scalar)
+			ssBody << "store i8* " << vals[i] << ", i8** "
+			       << argVars[i].internal << std::endl;
+		else
+			stackStore(argVars[i].internal, vals[i]);
+	popLifetime();
+
+	ssBody << "br label " << labelTop << std::endl
+	       << std::endl
+	       << makeUnique("Lunreach").substr(1) << ":" << std::endl;
+
+	return "null";
+}
+std::string CompileUnit::compileMake (ExpPtr e, EnvPtr env)
+{
+	// ^make construct for manually creating runtime objects
+	auto tys = e->subexps[0]->getType()->subtypes;
+	while (!tys.tail().nil())
+		++tys;
+	auto tag = GlobEnv::getTag(tys.head()->name, e->subexps[0]->getString());
+
+	std::vector<std::string> vals;
+	vals.reserve(e->subexps.size() - 1);
+
+	pushLifetime();
+	for (size_t i = 1, len = e->subexps.size(); i < len; i++)
+		vals.push_back(compile(e->subexps[i], env, true));
+	auto res = makeObject(tag, vals);
+	popLifetime();
+
+	return res;
+}
+
 std::string CompileUnit::compileLet (ExpPtr e, EnvPtr env)
 {
-	auto internal = makeUnique(Compiler::mangle(e->getString()));
-	stackAlloc(internal);
+	auto init = e->subexps[0];
 
+	if (knownLambdas.find(init) != knownLambdas.end())
+	{
+		// no closure needed, just remember what it captures
+		knownEnvs[init] = captureVars(init, env);
+		env->vars.push_back({ e->getString(), "", false, false, init });
+		return "null";
+	}
+
+	auto internal = makeUnique(Compiler::mangle(e->getString()));
 	auto mut = e->get<bool>();
 
 	// don't create a box for variable already boxed
@@ -711,13 +1275,24 @@ std::string CompileUnit::compileLet (ExpPtr e, EnvPtr env)
 		e->subexps[0]->kind == eiGet &&
 		e->subexps[0]->subexps[0]->kind == eiEnv;
 
-	auto boxing = mut && !unboxing;
+	auto boxing = mut && !unboxing &&
+		captured.find(e->getString()) != captured.end();
+
+	// plain allocas that 'opt -mem2reg' can turn into registers
+	auto scalar = !boxing && !unboxing && immediateType(letTypes[e]);
+
+	if (scalar)
+		ssPrefix << internal << " = alloca i8*" << std::endl;
+	else
+		stackAlloc(internal);
 
 	env->vars.push_back({
 		e->getString(),
 		internal,
 		true,
-		mut,
+		boxing || (mut && unboxing),
+		nullptr,
+		scalar
 	});
 
 	if (boxing) pushLifetime();
@@ -727,12 +1302,24 @@ std::string CompileUnit::compileLet (ExpPtr e, EnvPtr env)
 	if (boxing)
 	{
 		auto box = makeUnique(".box");
-		ssBody << box << " = call i8* @ju_make_box (i8* " << res << ")" << std::endl;
+
+		if (stackObjs.find(e) != stackObjs.end())
+		{
+			auto ptr = stackObject(1, false);
+			ssBody << box << " = call i8* @ju_stack_box (i8* " << ptr
+			       << ", i8* " << res << ")" << std::endl;
+		}
+		else
+			ssBody << box << " = call i8* @ju_make_box (i8* " << res << ")" << std::endl;
 		res = box;
 
 		popLifetime();
 	}
-	stackStore(internal, res);
+
+	if (scalar)
+		ssBody << "store i8* " << res << ", i8** " << internal << std::endl;
+	else
+		stackStore(internal, res);
 
 	return "null"; // returns unit
 }
@@ -760,6 +1347,11 @@ std::string CompileUnit::compileBlock (ExpPtr e, EnvPtr penv)
 
 std::string CompileUnit::compileCond (ExpPtr e, EnvPtr env)
 {
+	int_t tag;
+	auto scrut = tagTest(e->subexps[0], tag);
+	if (scrut != nullptr)
+		return compileSwitch(e, scrut, env);
+
 	/*
 		br <cond>, <then>, <else>
 	*/
@@ -805,6 +1397,106 @@ std::string CompileUnit::compileCond (ExpPtr e, EnvPtr env)
 	ssBody << res << " = load i8** " << tmp << std::endl;
 	return res;
 }
+ExpPtr CompileUnit::tagTest (ExpPtr test, int_t& tag)
+{
+	// 'x.ctor?' calls the generated tester, whose body is
+	//  just the tag check on its argument
+	ExpPtr arg, cmp = test;
+
+	if (test->kind == eCall && test->subexps.size() == 2 &&
+			test->subexps[0]->kind == eVar && test->subexps[0]->get<bool>())
+	{
+		auto it = special.find(test->subexps[0]);
+		if (it == special.end())
+			return nullptr;
+
+		cmp = it->second->overload->body;
+		arg = test->subexps[1];
+
+		if (cmp == nullptr || cmp->kind != eiTag ||
+				cmp->subexps[0]->kind != eVar)
+			return nullptr;
+	}
+	else if (test->kind == eiTag)
+		arg = test->subexps[0];
+	else
+		return nullptr;
+
+	if (arg->kind != eVar || arg->get<bool>())
+		return nullptr;
+
+	tag = cmp->get<int_t>();
+	return arg;
+}
+std::string CompileUnit::compileSwitch (ExpPtr e, ExpPtr scrut, EnvPtr env)
+{
+	/*
+		if x.a? then A else if x.b? then B else C
+		  =>
+		switch <tag of x>, <C> [ <a>, <A>  <b>, <B> ]
+	*/
+	std::vector<std::pair<int_t, ExpPtr>> cases;
+	std::set<int_t> seen;
+	auto other = e;
+
+	for (;;)
+	{
+		int_t tag;
+		ExpPtr var;
+
+		if (other->kind != eCond ||
+				(var = tagTest(other->subexps[0], tag)) == nullptr ||
+				var->getString() != scrut->getString())
+			break;
+
+		// a repeated test can never succeed
+		if (seen.insert(tag).second)
+			cases.push_back({ tag, other->subexps[1] });
+		other = other->subexps[2];
+	}
+
+	auto res = makeUnique(".cond");
+	auto tmp = makeUnique(".t");
+	auto lother = makeUnique("Lelse");
+	auto lend = makeUnique("Lend");
+	std::vector<std::string> labels;
+
+	ssBody << tmp << " = alloca i8*" << std::endl
+	       << "store i8* null, i8** " << tmp << std::endl;
+
+	auto val = compile(scrut, env, false);
+	auto tag = loadTag(val);
+
+	ssBody << "switch i32 " << tag << ", label " << lother << " [";
+	for (auto& c : cases)
+	{
+		labels.push_back(makeUnique("Lcase"));
+		ssBody << " i32 " << c.first << ", label " << labels.back();
+	}
+	ssBody << " ]" << std::endl;
+
+	for (size_t i = 0, len = cases.size(); i < len; i++)
+	{
+		ssBody << std::endl
+		       << labels[i].substr(1) << ":" << std::endl;
+
+		auto r = compile(cases[i].second, env, false);
+		ssBody << "store i8* " << r << ", i8** " << tmp << std::endl
+		       << "br label " << lend << std::endl;
+	}
+
+	ssBody << std::endl
+	       << lother.substr(1) << ":" << std::endl;
+
+	auto r = compile(other, env, false);
+	ssBody << "store i8* " << r << ", i8** " << tmp << std::endl
+	       << "br label " << lend << std::endl
+	       << std::endl
+	       << lend.substr(1) << ":" << std::endl
+	       << res << " = load i8** " << tmp << std::endl;
+
+	return res;
+}
 std::string CompileUnit::compileLoop (ExpPtr e, EnvPtr penv)
 {
 	auto env = makeEnv(penv);
@@ -843,70 +1535,167 @@ std::string CompileUnit::compileLoop (ExpPtr e, EnvPtr penv)
 
 std::string CompileUnit::compileiGet (ExpPtr e, EnvPtr env)
 {
+	if (flatEnv >= 0 && e->subexps[0]->kind == eiEnv)
+	{
+		// captured variables are passed as arguments
+		std::ostringstream ss;
+		ss << ENV_VAR << e->get<int_t>();
+		return ss.str();
+	}
+
 	pushLifetime();
-	auto res = makeUnique(".get");
 	auto inp = compile(e->subexps[0], env, true);
+	auto idx = e->get<int_t>();
+
+	if (e->subexps[0]->kind == eiEnv)
+	{
+		// the closure always has its captured variables
+		popLifetime();
+		return loadMember(inp, idx);
+	}
+
+	/*
+		br <immediate>, <cold>, <obj>
+		obj: br <tag matches / index in bounds>, <ok>, <cold>
+		ok:  <load member>
+		cold: <ju_safe_get / ju_get, which report the error>
+	*/
+	auto res = makeUnique(".get");
+	auto test = makeUnique(".cmp");
+	auto v1 = makeUnique(".v");
+	auto v2 = makeUnique(".v");
+	auto lobj = makeUnique("Lobj");
+	auto lok = makeUnique("Lok");
+	auto lcold = makeUnique("Lcold");
+	auto lend = makeUnique("Lend");
+
+	auto imm = isImmediate(inp);
+	ssBody << "br i1 " << imm
+	       << ", label " << lcold
+	       << ", label " << lobj << std::endl
+	       << std::endl
+	       << lobj.substr(1) << ":" << std::endl;
+
+	auto hdr = makeUnique(".hdr");
+	auto field = makeUnique(".f");
+	auto fval = makeUnique(".f");
+	ssBody << hdr << " = bitcast i8* " << inp << " to %ju_obj*" << std::endl;
+
+	if (e->getString() == "")
+		ssBody << field << " = getelementptr inbounds %ju_obj* " << hdr
+		       << ", i32 0, i32 " OBJ_NMEMS << std::endl
+		       << fval << " = load i32* " << field << std::endl
+		       << test << " = icmp ult i32 " << idx << ", " << fval << std::endl;
+	else
+		ssBody << field << " = getelementptr inbounds %ju_obj* " << hdr
+		       << ", i32 0, i32 " OBJ_TAG << std::endl
+		       << fval << " = load i32* " << field << std::endl
+		       << test << " = icmp eq i32 " << fval << ", "
+		       << e->get<CtorField>().tag << std::endl;
+
+	ssBody << "br i1 " << test
+	       << ", label " << lok
+	       << ", label " << lcold << std::endl
+	       << std::endl
+	       << lok.substr(1) << ":" << std::endl;
+
+	auto mem = memberAddr(inp, idx);
+	ssBody << v1 << " = load i8** " << mem << std::endl
+	       << "br label " << lend << std::endl
+	       << std::endl
+	       << lcold.substr(1) << ":" << std::endl;
 
 	if (e->getString() == "")
-		ssBody << res << " = call i8* @ju_get (i8* " << inp
-		       << ", i32 " << e->get<int_t>() << ")" << std::endl;
+		ssBody << v2 << " = call i8* @ju_get (i8* " << inp
+		       << ", i32 " << idx << ")" << std::endl;
 	else
 	{
-		auto tag = GlobEnv::getTag(e->getString());
+		auto tag = e->get<CtorField>().tag;
 		auto str = makeGlobalString(e->getString(), true);
 
-		ssBody << res << " = call i8* @ju_safe_get (i8* "
+		ssBody << v2 << " = call i8* @ju_safe_get (i8* "
 			   << inp << ", i8* " << str << ", i32 " << tag
-			   << ", i32 " << e->get<int_t>() << ")" << std::endl;
+			   << ", i32 " << idx << ")" << std::endl;
 	}
+
+	ssBody << "br label " << lend << std::endl
+	       << std::endl
+	       << lend.substr(1) << ":" << std::endl
+	       << res << " = phi i8* [ " << v1 << ", " << lok
+	       << " ], [ " << v2 << ", " << lcold << " ]" << std::endl;
+
 	popLifetime();
 	return res;
 }
 
 std::string CompileUnit::compileiTag (ExpPtr e, EnvPtr env)
 {
-	auto tag = makeUnique(".tag");
 	auto cmp = makeUnique(".cmp");
 	auto res = makeUnique(".r");
 	auto inp = compile(e->subexps[0], env, true);
+	auto tag = loadTag(inp);
 
-	ssBody << tag << " = call i32 @ju_get_tag (i8* " << inp << ")" << std::endl
-	       << cmp << " = icmp eq i32 " << tag << ", "
-	       << GlobEnv::getTag(e->getString()) << std::endl
+	ssBody << cmp << " = icmp eq i32 " << tag << ", "
+	       << e->get<int_t>() << std::endl
 	       << res << " = inttoptr i1 " << cmp << " to i8* " << std::endl;
 
 	return res;
 }
 
-std::string CompileUnit::compileLambda (ExpPtr e, EnvPtr env)
+std::vector<CompileUnit::Var> CompileUnit::captureVars (ExpPtr lambda, EnvPtr env)
 {
-	auto cunit = special[e];
-	auto res = makeUnique(".lm");
+	std::vector<Var> vars;
+	vars.reserve(lambda->subexps.size() - 1);
 
-	std::ostringstream args;
+	for (size_t i = 1, len = lambda->subexps.size(); i < len; i++)
+		vars.push_back(env->get(lambda->subexps[i]->getString()));
 
-	// make env from variables
-	for (size_t i = 1, len = e->subexps.size(); i < len; i++)
-	{
-		auto name = e->subexps[i]->getString();
-		auto var = env->get(name);
+	return vars;
+}
+std::vector<std::string> CompileUnit::compileCaptures (const std::vector<Var>& vars)
+{
+	std::vector<std::string> vals;
+	vals.reserve(vars.size());
 
+	// boxed variables are passed as the box itself
+	for (auto& var : vars)
 		if (var.stackAlloc)
 		{
 			auto tmp = makeUnique(".v");
-			args << ", i8* " << tmp;
 			ssBody << tmp << " = load i8** " << var.internal << std::endl;
+			vals.push_back(tmp);
 		}
 		else
-			args << ", i8* " << var.internal;
-	}
+			vals.push_back(var.internal);
 
-	ssBody << res << " = call i8* (i8*, i32, ...)* @ju_closure ("
-		   << "i8* bitcast (i8* ("
-		   << joinCommas(cunit->overload->signature->args.size() + 1, "i8*")
-		   << ")* @" << cunit->internalName
-		   << " to i8*), i32 " << (e->subexps.size() - 1) << args.str() << ")" << std::endl;
+	return vals;
+}
+std::string CompileUnit::compileLambda (ExpPtr e, EnvPtr env)
+{
+	auto cunit = special[e];
+	auto res = makeUnique(".lm");
+
+	// make env from variables
+	auto vals = compileCaptures(captureVars(e, env));
+
+	std::ostringstream fn;
+	fn << "i8* bitcast (i8* ("
+	   << joinCommas(cunit->overload->signature->args.size() + 1, "i8*")
+	   << ")* @" << cunit->internalName << " to i8*)";
+
+	if (stackObjs.find(e) != stackObjs.end())
+	{
+		// closure doesn't outlive this function
+		auto ptr = stackObject(vals.size(), true);
 
+		ssBody << res << " = call i8* @ju_stack_closure (i8* " << ptr
+		       << ", " << fn.str() << ", i32 " << vals.size() << ")" << std::endl;
+	}
+	else
+		ssBody << res << " = call i8* @ju_alloc_closure ("
+		       << fn.str() << ", i32 " << vals.size() << ")" << std::endl;
+
+	storeMembers(res, vals, true);
 	return res;
 }
 
@@ -914,18 +1703,31 @@ std::string CompileUnit::compileAssign (ExpPtr e, EnvPtr env)
 {
 	auto var = env->get(e->subexps[0]->getString());
 	auto res = compile(e->subexps[1], env, false);
+
+	if (var.scalar)
+	{
+		ssBody << "store i8* " << res << ", i8** " << var.internal << std::endl;
+		return "null";
+	}
+	else if (!var.mut)
+	{
+		// not captured by any lambda, so not boxed
+		stackStore(var.internal, res);
+		return "null";
+	}
+
 	auto box = makeUnique(".box");
+	ssBody << box << " = load i8** " << var.internal << std::endl;
 
-	ssBody << box << " = load i8** " << var.internal << std::endl
-	       << "call void @ju_put (i8* " << box << ", i32 0, i8* " << res << ")" << std::endl;
+	stackStore(memberAddr(box, 0), res);
 
 	return "null";
 }
 
 std::string CompileUnit::compileList (ExpPtr e, EnvPtr env)
 {
-	static auto tag_nil = GlobEnv::getTag("nil");
-	static auto tag_cons = GlobEnv::getTag("cons");
+	static auto tag_nil = GlobEnv::getTag("List", "nil");
+	static auto tag_cons = GlobEnv::getTag("List", "cons");
 
 	std::vector<std::string> items;
 	items.reserve(e->subexps.size());
@@ -935,12 +1737,11 @@ std::string CompileUnit::compileList (ExpPtr e, EnvPtr env)
 	for (auto& e2 : e->subexps)
 		items.push_back(compile(e2, env, true));
 
-	auto res = makeUnique(".l");
 	std::string temp = "";
+	bool onStack = stackObjs.find(e) != stackObjs.end();
 
 	// make 'nil'
-	ssBody << res << " = call i8* (i32, i32, i32, ...)* @ju_make_buf(i32 "
-	       << tag_nil << ", i32 0, i32 0)" << std::endl;
+	auto res = makeObject(tag_nil, {});
 
 	// iterate cells backwards
 	// let x = [1, 2, 3]
@@ -951,7 +1752,19 @@ std::string CompileUnit::compileList (ExpPtr e, EnvPtr env)
 	for (auto it = items.rbegin(); it != items.rend(); ++it)
 	{
 		auto prev = res;
-		res = makeUnique(".l");
+
+		if (onStack)
+		{
+			// cells don't outlive this function, and nothing
+			//  here allocates so prev needs no root
+			auto ptr = stackObject(2, false);
+			res = makeUnique(".l");
+
+			ssBody << res << " = call i8* @ju_stack_buf (i8* " << ptr
+			       << ", i32 " << tag_cons << ", i32 2)" << std::endl;
+			storeMembers(res, { *it, prev }, false);
+			continue;
+		}
 
 		// root prev cell
 		if (temp.empty())
@@ -959,9 +1772,7 @@ std::string CompileUnit::compileList (ExpPtr e, EnvPtr env)
 		stackStore(temp, prev);
 
 		// make 'cons'
-		ssBody << res << " = call i8* (i32, i32, i32, ...)* @ju_make_buf(i32 "
-		       << tag_cons << ", i32 0, i32 2, i8* "
-		       << *it << ", i8* " << prev << ")" << std::endl;
+		res = makeObject(tag_cons, { *it, prev });
 	}
 
 	popLifetime();
@@ -19,18 +19,37 @@ struct CompileUnit
 	OverloadPtr overload;
 	std::string internalName;
 	FuncInstance funcInst;
+	ExpPtr body;
 
 	std::ostringstream ssPrefix;
 	std::ostringstream ssBody;
 	std::ostringstream ssEnd;
 
 	bool finishedInfer;
+	bool pendingEmit;
+	bool live;
+	bool baked;
+	bool rootsArgs;
+	int flatEnv;
 	std::map<ExpPtr, CompileUnit*> special;
+	std::vector<std::string> externals;
 	std::set<std::string> nonUnique;
 	std::vector<int> tempLifetimes;
 	std::set<ExpPtr> tailCalls;
+	std::set<ExpPtr> switchTests;
+	std::set<ExpPtr> knownLambdas;
+	std::set<std::string> captured;
+	std::map<ExpPtr, TyPtr> letTypes;
 	int lifetime;
 	size_t nroots;
+	int nglobals;
+
+	// arguments (and environment, last) that may escape or be
+	//  returned, and allocations that can live in the frame
+	int escapeState;
+	std::vector<bool> argEscapes;
+	std::vector<bool> argReturned;
+	std::set<ExpPtr> stackObjs;
 
 	struct Loop
 	{
@@ -43,6 +62,8 @@ struct CompileUnit
 		std::string internal;
 		bool stackAlloc;
 		bool mut;
+		ExpPtr lambda;
+		bool scalar;
 	};
 	struct Env
 	{
@@ -53,6 +74,10 @@ struct CompileUnit
 		Env (CompileUnit* cunit, EnvPtr parent);
 		Var get (const std::string& name) const;
 	};
+	std::map<ExpPtr, std::vector<Var>> knownEnvs;
+	std::vector<Var> argVars;
+	std::string labelTop;
+	std::map<CompileUnit*, std::string> rootWrappers;
 
 	CompileUnit (Compiler* comp, OverloadPtr overload, SigPtr sig);
 	CompileUnit (Compiler* comp, OverloadPtr overload,
@@ -60,6 +85,11 @@ struct CompileUnit
 	               const std::string& intName);
 
 	void compile ();
+	// runs on a worker thread (see Compiler::emit): it may only touch
+	//  this unit's own state and read-only analysis results (types,
+	//  escapes, live flags) of other units; anything shared with the
+	//  compiler is collected per unit and merged afterwards
+	void emit ();
 
 	void writePrefix (EnvPtr env);
 	void writeEnd ();
@@ -69,6 +99,17 @@ struct CompileUnit
 	void stackAlloc (const std::string& name);
 	void stackStore (const std::string& name, 
 						const std::string& value);
+	std::string stackObject (size_t nmems, bool closure);
+	void storeMembers (const std::string& ptr,
+						const std::vector<std::string>& vals,
+						bool closure);
+	std::string makeObject (int_t tag,
+						const std::vector<std::string>& vals);
+	std::string memberAddr (const std::string& val, int_t i);
+	std::string loadMember (const std::string& val, int_t i);
+	std::string isImmediate (const std::string& val);
+	std::string loadTag (const std::string& val);
+	ExpPtr tagTest (ExpPtr test, int_t& tag);
 
 	EnvPtr makeEnv (EnvPtr parent = nullptr);
 	std::string makeUnique (const std::string& str);
@@ -82,6 +123,20 @@ struct CompileUnit
 	bool needsRetain (ExpPtr exp);
 	bool doesTailCall (ExpPtr exp) const;
 	void findTailCalls (ExpPtr exp);
+	void findSwitchTests (ExpPtr exp);
+	void findFuncValues (ExpPtr exp);
+	std::string rootWrapper (CompileUnit* cunit);
+	void findKnownLambdas ();
+	ExpPtr knownCallee (ExpPtr fn, EnvPtr env);
+	std::vector<Var> captureVars (ExpPtr lambda, EnvPtr env);
+	std::vector<std::string> compileCaptures (const std::vector<Var>& vars);
+
+	// located in "CompileEscape.cpp"
+	void analyzeEscapes ();
+	// located in "CompileInline.cpp"
+	void inlineCalls ();
+	// located in "CompileFusion.cpp"
+	void fuseLoops ();
 
 	std::string compile (ExpPtr exp, EnvPtr env,
 					bool retain = true);
@@ -90,9 +145,12 @@ struct CompileUnit
 	std::string compileReal (ExpPtr e, EnvPtr env);
 	std::string compileVar (ExpPtr e, EnvPtr env);
 	std::string compileCall (ExpPtr e, EnvPtr env);
+	std::string compileSelfTail (ExpPtr e, EnvPtr env);
+	std::string compileMake (ExpPtr e, EnvPtr env);
 	std::string compileLet (ExpPtr e, EnvPtr env);
 	std::string compileBlock (ExpPtr e, EnvPtr env);
 	std::string compileCond (ExpPtr e, EnvPtr env);
+	std::string compileSwitch (ExpPtr e, ExpPtr scrut, EnvPtr env);
 	std::string compileLambda (ExpPtr e, EnvPtr env);
 	std::string compileAssign (ExpPtr e, EnvPtr env);
 	std::string compileLoop (ExpPtr e, EnvPtr env);
@@ -101,6 +159,10 @@ struct CompileUnit
 	std::string compileiTag (ExpPtr e, EnvPtr env);
 };
 
+// variables assigned to, or declared mutable, anywhere in 'e'
+//  (located in "CompileInline.cpp")
+void findMutable (ExpPtr e, std::set<std::string>& out);
+
 
 
 class Compiler
@@ -119,6 +181,8 @@ public:
 						const std::string& internalName);
 
 	void entryPoint (CompileUnit* cunit);
+	static void markLive (CompileUnit* root);
+	void emit ();
 	void output (std::ostream& os);
 	void outputInfodata (std::ostream& os);
 
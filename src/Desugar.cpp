@@ -313,26 +313,32 @@ ExpPtr Desugar::desugarForEach (ExpPtr e, LocEnvPtr lenv)
 	/*	for x1 : (e1) { e2 }
 	{
 		let t1 = (e1);
-		loop cons?(t1) {
-			let x1 = hd(t1);
+		let t2 = cursor(t1);
+		loop more?(t1, t2) {
+			let x1 = at(t1, t2);
 			{ e2 };
-			t1 = tl(t1);
+			t2 = advance(t1, t2);
 		}
-	} */
+	}
+	the cursor functions are overloaded in the stdlib, so
+	 anything with them (lists, arrays, lazy iterators) can be
+	 looped over */
 	auto span = e->span;
-	auto v_cons = Exp::make(eVar, std::string("cons?"), {}, span);
-	auto v_hd = Exp::make(eVar, std::string("hd"), {}, span);
-	auto v_tl = Exp::make(eVar, std::string("tl"), {}, span);
+	auto v_cursor = Exp::make(eVar, std::string("cursor"), {}, span);
+	auto v_more = Exp::make(eVar, std::string("more?"), {}, span);
+	auto v_at = Exp::make(eVar, std::string("at"), {}, span);
+	auto v_advance = Exp::make(eVar, std::string("advance"), {}, span);
 	auto block1 = Exp::make(eBlock, {}, span);
 	auto block2 = Exp::make(eBlock, {}, span);
 	auto t1 = genVar(block1, e->subexps[0]);
+	auto t2 = genVar(block1, Exp::make(eCall, { v_cursor, t1 }, span));
 
-	auto cons = Exp::make(eCall, { v_cons, t1 }, span);
-	auto loop = Exp::make(eLoop, { cons, block2 }, span);
-	auto hd = Exp::make(eCall, { v_hd, t1 }, span);
-	auto let = Exp::make(eLet, wc, e->getString(), { hd }, span);
-	auto tl = Exp::make(eCall, { v_tl, t1 }, span);
-	auto assign = Exp::make(eAssign, { t1, tl }, span);
+	auto more = Exp::make(eCall, { v_more, t1, t2 }, span);
+	auto loop = Exp::make(eLoop, { more, block2 }, span);
+	auto at = Exp::make(eCall, { v_at, t1, t2 }, span);
+	auto let = Exp::make(eLet, wc, e->getString(), { at }, span);
+	auto advance = Exp::make(eCall, { v_advance, t1, t2 }, span);
+	auto assign = Exp::make(eAssign, { t2, advance }, span);
 
 	block2->subexps.reserve(3);
 	block2->subexps.push_back(let);
@@ -411,12 +417,34 @@ SigPtr Desugar::desugar (SigPtr sig)
 
 	return Sig::make(args, sig->span);
 }
+static void findPolynames (TyPtr ty, std::map<std::string, TyPtr>& out)
+{
+	if (ty->kind == tyPoly && !ty->name.empty())
+		out[ty->name] = ty;
+
+	for (auto t : ty->subtypes)
+		findPolynames(t, out);
+}
+
+void Desugar::desugarSig (OverloadPtr overload)
+{
+	// the signature is needed for overload resolution, so this happens
+	//  for every overload before any code is compiled
+	if (overload->isSigDesugared) return;
+
+	overload->isSigDesugared = true;
+	overload->signature = desugar(overload->signature);
+}
 void Desugar::desugar (OverloadPtr overload)
 {
 	if (overload->isDesugared) return;
 
 	overload->isDesugared = true;
-	overload->signature = desugar(overload->signature);
+	desugarSig(overload);
+
+	// named polytypes in the body refer to the ones in the signature
+	for (auto& a : overload->signature->args)
+		findPolynames(a.second, polynames);
 
 	auto env = LocEnv::make();
 	for (auto& a : overload->signature->args)
@@ -16,6 +16,7 @@ struct Desugar
 
 	SigPtr desugar (SigPtr sig);
 	void desugar (OverloadPtr overload);
+	void desugarSig (OverloadPtr overload);
 
 	ExpPtr desugar (ExpPtr exp, LocEnvPtr lenv);
 	ExpPtr desugarSubexps (ExpPtr e, LocEnvPtr lenv);
@@ -11,7 +11,7 @@
 // ------------------------------------- GlobEnv -------------------------------------//
 
 GlobEnv::GlobEnv (const GlobProto& _proto)
-	: compiler(nullptr), proto(_proto)
+	: compiler(nullptr), isStdlib(false), proto(_proto)
 {
 	// TODO: integrate order-of-ops into jupiter syntax
 	using Op = GlobEnv::OpPrecedence;
@@ -42,6 +42,16 @@ void GlobEnv::loadBuiltinTypes ()
 	addType(TypeInfo("Char"));
 	addType(TypeInfo("Real"));
 	addType(TypeInfo("Str"));
+	addType(TypeInfo("Array", 1));
+	addType(TypeInfo("IntArray"));
+	addType(TypeInfo("RealArray"));
+	addType(TypeInfo("Map", 2));
+	addType(TypeInfo("PVec", 1));
+	addType(TypeInfo("TVec", 1));
+	addType(TypeInfo("PMap", 2));
+	addType(TypeInfo("TMap", 2));
+	addType(TypeInfo("PMapCursor"));
+	addType(TypeInfo("Lines"));
 }
 
 GlobEnv::~GlobEnv ()
@@ -118,23 +128,28 @@ void GlobEnv::loadToplevel ()
 OverloadPtr Overload::make (GlobEnv& env, const std::string& name,
                               SigPtr sig, ExpPtr body, bool isPub)
 {
-	return OverloadPtr(new Overload { env, name, sig, body, {}, false, isPub, false });
+	return OverloadPtr(new Overload { env, name, sig, body, {}, false, isPub, false, false });
 }
 
 FuncInstance Overload::inst (OverloadPtr over, SigPtr sig, Compiler* origin)
 {
+	// instances always belong to the overload's own compiler; other
+	//  compilers declare them when they output code that uses them
 	if (origin != over->env.compiler)
-	{
-		auto inst = Overload::inst(over, sig, over->env.compiler);
-		origin->addInclude(inst.cunit);
-		return inst;
-	}
+		return Overload::inst(over, sig, over->env.compiler);
 
 
 	for (auto cu : over->instances)
 		if (cu->funcInst.signature->aEquiv(sig))
 			return cu->funcInst;
 
+	// bodies are only desugared once they are actually used
+	if (!over->isDesugared)
+	{
+		Desugar desu(over->env);
+		desu.desugar(over);
+	}
+
 	auto cunit = over->env.compiler->compile(over, sig);
 	over->instances.push_back(cunit);
 	cunit->compile();
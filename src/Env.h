@@ -27,6 +27,7 @@ public:
 	bool hasEnv;
 	bool isPublic;
 	bool isDesugared;
+	bool isSigDesugared;
 
 	static OverloadPtr make (GlobEnv& env, const std::string& name,
 	                           SigPtr sig, ExpPtr body, bool isPub);
@@ -65,9 +66,10 @@ class GlobEnv
 {
 public:
 	using OpPrecedence = std::tuple<std::string, int, Assoc>;
-	static int_t getTag (const std::string& ident);
+	static int_t getTag (const std::string& type, const std::string& ctor);
 
 	Compiler* compiler;
+	bool isStdlib;
 	std::vector<OpPrecedence> operators;
 	std::vector<GlobFuncPtr> functions;
 	std::vector<TypeInfo*> types;
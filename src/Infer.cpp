@@ -34,6 +34,9 @@ Infer::Infer (CompileUnit* _cunit, SigPtr sig)
 
 	// update to new type
 	fn.returnType = mainSubs(fn.returnType);
+
+	for (auto& let : _cunit->letTypes)
+		let.second = mainSubs(let.second);
 }
 
 
@@ -142,6 +145,7 @@ TyPtr Infer::inferLet (ExpPtr exp, LocEnvPtr lenv)
 		throw exp->span.die("invalid for variable to have overloaded type");
 
 	lenv->newVar(exp->getString(), ty)->mut = exp->get<bool>();
+	fn.cunit->letTypes[exp] = ty;
 
 	return nullptr;
 }
@@ -265,6 +269,7 @@ TyPtr Infer::inferLambda (ExpPtr exp, LocEnvPtr lenv)
 	auto overload = Overload::make(env, lamName, sig, body, false);
 	overload->hasEnv = true;
 	overload->isDesugared = true;
+	overload->isSigDesugared = true;
 	env.addFunc(lamName)->overloads.push_back(overload);
 
 	return Ty::makeOverloaded(exp, lamName);
@@ -12,5 +12,6 @@ using real_t =   double;
 
 
 #define  JUP_LIB_PATH(p)   "./lib/" p
+#define  JUP_STDLIB        "std/stdlib"
 
 //
\ No newline at end of file
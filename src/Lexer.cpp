@@ -2,6 +2,14 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 // configurable?
@@ -83,6 +91,92 @@ static bool is_operator (char c)
 
 #endif
 
+// vectorized scanning
+//  the vector loops only recognize the common members of each
+//  character class (plain whitespace, alphanumerics) and leave the
+//  character that stopped them to the scalar functions above
+
+#if defined(__AVX2__)
+#define USE_VECTOR_SCAN
+
+struct Vec
+{
+	using T = __m256i;
+	enum { Width = 32 };
+	static const uint32_t Full = 0xffffffff;
+
+	static inline T load (const char* p) { return _mm256_loadu_si256((const T*) p); }
+	static inline T set (char c) { return _mm256_set1_epi8(c); }
+	static inline T eq (T a, T b) { return _mm256_cmpeq_epi8(a, b); }
+	static inline T gt (T a, T b) { return _mm256_cmpgt_epi8(a, b); }
+	static inline T both (T a, T b) { return _mm256_and_si256(a, b); }
+	static inline T either (T a, T b) { return _mm256_or_si256(a, b); }
+	static inline uint32_t mask (T a) { return uint32_t(_mm256_movemask_epi8(a)); }
+};
+
+#elif defined(__SSE2__)
+#define USE_VECTOR_SCAN
+
+struct Vec
+{
+	using T = __m128i;
+	enum { Width = 16 };
+	static const uint32_t Full = 0xffff;
+
+	static inline T load (const char* p) { return _mm_loadu_si128((const T*) p); }
+	static inline T set (char c) { return _mm_set1_epi8(c); }
+	static inline T eq (T a, T b) { return _mm_cmpeq_epi8(a, b); }
+	static inline T gt (T a, T b) { return _mm_cmpgt_epi8(a, b); }
+	static inline T both (T a, T b) { return _mm_and_si128(a, b); }
+	static inline T either (T a, T b) { return _mm_or_si128(a, b); }
+	static inline uint32_t mask (T a) { return uint32_t(_mm_movemask_epi8(a)); }
+};
+
+#endif
+
+#ifdef USE_VECTOR_SCAN
+
+// (lo <= v <= hi) for signed bytes
+static inline Vec::T vec_range (Vec::T v, char lo, char hi)
+{
+	return Vec::both(Vec::gt(v, Vec::set(lo - 1)),
+	                 Vec::gt(Vec::set(hi + 1), v));
+}
+
+// each returns the length of the leading run at 'p' (Width if the
+//  run covers the entire vector)
+static inline size_t vec_space (const char* p)
+{
+	auto v = Vec::load(p);
+	auto m = Vec::either(
+			Vec::either(Vec::eq(v, Vec::set(' ')), Vec::eq(v, Vec::set('\t'))),
+			Vec::either(Vec::eq(v, Vec::set('\n')), Vec::eq(v, Vec::set('\r'))));
+
+	auto bits = Vec::mask(m);
+	return bits == Vec::Full ? Vec::Width : __builtin_ctz(~bits);
+}
+static inline size_t vec_alnum (const char* p)
+{
+	auto v = Vec::load(p);
+	auto lower = Vec::either(v, Vec::set(0x20));
+	auto m = Vec::either(
+			Vec::either(vec_range(v, '0', '9'), vec_range(lower, 'a', 'z')),
+			Vec::eq(v, Vec::set('_')));
+
+	auto bits = Vec::mask(m);
+	return bits == Vec::Full ? Vec::Width : __builtin_ctz(~bits);
+}
+static inline size_t vec_find (const char* p, char c)
+{
+	auto bits = Vec::mask(Vec::eq(Vec::load(p), Vec::set(c)));
+	return bits == 0 ? Vec::Width : __builtin_ctz(bits);
+}
+
+#endif
+
+
+bool Lexer::vectorScan = true;
+
 std::vector<std::pair<std::string, int>> Lexer::keywords {
 	{ "if",    tIf },
 	{ "then",  tThen },
@@ -153,6 +247,59 @@ void Lexer::generateKeyMaps ()
 	std::cout << "\n};" << std::endl;
 }
 
+void Lexer::benchmark (size_t megabytes)
+{
+	using Clock = std::chrono::steady_clock;
+
+	// synthetic source resembling a generated module
+	static const char chunk[] =
+		"# generated module\n"
+		"pub func accumulate_values (list : [Int], initial_value : Int) {\n"
+		"\tlet mut_total = initial_value;   # running total\n"
+		"\tfor item : list {\n"
+		"\t\tif item.isPositive? then\n"
+		"\t\t\tmut_total = mut_total + item * 31 - 7;\n"
+		"\t\tprintln(\"accumulated value so far: \", mut_total);\n"
+		"\t}\n"
+		"\tmut_total.foldl(0, \\acc, x -> acc + x) >= 1024.5\n"
+		"}\n\n";
+
+	std::string src;
+	src.reserve(megabytes << 20);
+	while (src.size() < (megabytes << 20))
+		src += chunk;
+
+	auto run = [&] (bool vec, size_t& ntoks) -> double
+	{
+		vectorScan = vec;
+		ntoks = 0;
+
+		Lexer lex;
+		auto start = Clock::now();
+		lex.openString(src, "<benchmark>");
+		while (lex.current() != tEOF)
+		{
+			lex.advance();
+			ntoks++;
+		}
+		std::chrono::duration<double> dt = Clock::now() - start;
+		return dt.count();
+	};
+
+	size_t tokScalar, tokVector;
+	auto tScalar = run(false, tokScalar);
+	auto tVector = run(true, tokVector);
+	vectorScan = true;
+
+	auto mb = double(src.size()) / (1 << 20);
+	std::cout << "lexed " << mb << " MB, " << tokScalar << " tokens" << std::endl
+	          << "  scalar: " << tScalar << " s  (" << (mb / tScalar) << " MB/s)" << std::endl
+	          << "  vector: " << tVector << " s  (" << (mb / tVector) << " MB/s)" << std::endl;
+
+	if (tokScalar != tokVector)
+		std::cout << "  MISMATCH: vector scan produced " << tokVector << " tokens" << std::endl;
+}
+
 
 
 
@@ -249,16 +396,80 @@ char Lexer::_adv ()
 	return c;
 }
 
+size_t Lexer::_scanSpace (size_t pos)
+{
+	auto data = _file->data();
+	auto size = _file->filesize();
+
+	while (pos < size)
+	{
+#ifdef USE_VECTOR_SCAN
+		if (vectorScan && pos + Vec::Width <= size)
+		{
+			auto n = vec_space(data + pos);
+			pos += n;
+			if (n == Vec::Width)
+				continue;
+		}
+#endif
+		if (pos < size && is_space(data[pos]))
+			pos++;
+		else
+			break;
+	}
+	return pos;
+}
+size_t Lexer::_scanIdent (size_t pos)
+{
+	auto data = _file->data();
+	auto size = _file->filesize();
+
+	while (pos < size)
+	{
+#ifdef USE_VECTOR_SCAN
+		if (vectorScan && pos + Vec::Width <= size)
+		{
+			auto n = vec_alnum(data + pos);
+			pos += n;
+			if (n == Vec::Width)
+				continue;
+		}
+#endif
+		if (pos < size && is_ident(data[pos]))
+			pos++;
+		else
+			break;
+	}
+	return pos;
+}
+size_t Lexer::_scanUntil (size_t pos, char c)
+{
+	auto data = _file->data();
+	auto size = _file->filesize();
+
+#ifdef USE_VECTOR_SCAN
+	if (vectorScan)
+		while (pos + Vec::Width <= size)
+		{
+			auto n = vec_find(data + pos, c);
+			pos += n;
+			if (n < Vec::Width)
+				return pos;
+		}
+#endif
+	while (pos < size && data[pos] != c)
+		pos++;
+	return pos;
+}
+
 void Lexer::_trim ()
 {
 	for (;;)
 	{
-		while (!_eof() && is_space(_peek()))
-			_adv();
+		_filepos = _scanSpace(_filepos);
 
 		if (_peek() == COMMENT)
-			while (!_eof() && _peek() != '\n')
-				_adv();
+			_filepos = _scanUntil(_filepos, '\n');
 		else
 			break;
 	}
@@ -285,9 +496,7 @@ void Lexer::_number (const std::string& str)
 		_adv();
 
 		auto start = _filepos;
-
-		while (is_ident(_peek()))
-			_adv();
+		_filepos = _scanIdent(_filepos);
 
 		auto sp = Span(_file, start, _filepos);
 		auto str = sp.data();
@@ -319,8 +528,7 @@ void Lexer::_number (const std::string& str)
 }
 void Lexer::_ident ()
 {
-	while (is_ident(_peek()))
-		_adv();
+	_filepos = _scanIdent(_filepos);
 
 	_current.span.end = _filepos;
 
@@ -344,23 +552,18 @@ void Lexer::_ident ()
 void Lexer::_string ()
 {
 	auto quote = _adv();
+	auto start = _filepos;
 
-	std::ostringstream ss;
-
-	while (_peek() != quote)
-	{
-		if (_eof())
-			throw (_current.span * 1).die(
-				"expected closing \" before <end-of-file>");
+	_filepos = _scanUntil(_filepos, quote);
+	if (_eof())
+		throw (_current.span * 1).die(
+			"expected closing \" before <end-of-file>");
 
-		ss << _adv();
-	}
-	
+	_current.str = _file->get(start, _filepos);
 	_adv();
 
 	_current.span.end = _filepos;
 	_current.tok = tString;
-	_current.str = ss.str();
 }
 
 
@@ -69,6 +69,7 @@ public:
 	inline std::string filename () const { return _fname; }
 	inline size_t filesize () const { return _data.size(); }
 	inline bool badfile () const { return _badfile; }
+	inline const char* data () const { return _data.data(); }
 
 	char get (size_t pos) const;
 	std::string get (size_t start, size_t end) const;
@@ -188,7 +189,11 @@ public:
 
 	static std::vector<std::pair<std::string, int>> keywords;
 
+	// use the SSE2/AVX2 scanning loops when available
+	static bool vectorScan;
+
 	static void generateKeyMaps ();
+	static void benchmark (size_t megabytes);
 private:
 	LexFile::ptr _file;
 	size_t _filepos;
@@ -201,6 +206,10 @@ private:
 	char _peek ();
 	char _adv ();
 
+	size_t _scanSpace (size_t pos);
+	size_t _scanIdent (size_t pos);
+	size_t _scanUntil (size_t pos, char c);
+
 	void _number (const std::string& str);
 	void _ident ();
 	void _string ();
@@ -0,0 +1,44 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+// runs task(i) for each i in [0, n) on a pool of threads
+//  if any tasks throw, the exception from the lowest index is
+//  rethrown after every thread has finished, so errors are
+//  reported in the same order as a serial loop
+template <typename F>
+void parallelFor (size_t n, F task)
+{
+	std::vector<std::exception_ptr> errors(n);
+	std::atomic<size_t> next(0);
+
+	auto worker = [&] ()
+	{
+		for (size_t i; (i = next++) < n; )
+			try
+			{
+				task(i);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+	};
+
+	size_t nthreads = std::min<size_t>(n,
+			std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < nthreads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& t : threads)
+		t.join();
+
+	for (auto& err : errors)
+		if (err != nullptr)
+			std::rethrow_exception(err);
+}
@@ -4,12 +4,28 @@
 #include <iostream>
 #include <functional>
 #include <set>
-
-int_t GlobEnv::getTag (const std::string& ident)
+#include <map>
+
+/*
+	constructors are numbered by their position in their type's
+	 declaration, so every module that sees a type agrees on its tags
+	 without having to share anything, and a tag test on a type with
+	 'n' constructors only ever compares against 0 .. n-1
+	the tests and field accesses generated for a constructor carry
+	 their tag, this is only needed to build objects
+*/
+static std::map<std::pair<std::string, std::string>, int_t> ctorTags;
+
+int_t GlobEnv::getTag (const std::string& type, const std::string& ctor)
 {
-	// PLEASE NO HASH COLLISIONS THANK YOU
+	auto it = ctorTags.find({ type, ctor });
+	if (it != ctorTags.end())
+		return it->second;
+
+	// ^make with a name that isn't a constructor, keep it
+	//  well away from the dense tags
 	std::hash<std::string> hash;
-	return int_t(hash(ident) & 0x7fffffff);
+	return int_t(hash(ctor) & 0x3fffffff) | 0x40000000;
 }
 
 
@@ -46,7 +62,7 @@ static TyPtr fillTypes (TyPtr ty, const TyList& pool, const Span& span)
 static void generateCtor (GlobProto& proto,
 	                        std::set<std::string>& fields,
                             TyPtr mainty, const std::string& ctorname,
-                            const SigPtr& sig, const Span& span)
+                            int_t tag, const SigPtr& sig, const Span& span)
 {
 	ExpList callArgs;
 	auto exp_make = Exp::make(eiMake, ctorname, {}, span);
@@ -68,9 +84,15 @@ static void generateCtor (GlobProto& proto,
 
 
 	auto util_sig = Sig::make({ { "a", mainty } }, span);
-	auto util_var = Exp::make(eVar, std::string("a"), {}, span);
 
-	auto exp_cmp = Exp::make(eiTag, ctorname, { util_var }, span);
+	// desugaring updates variables in place, so each function
+	//  gets its own copy
+	auto util_var = [&] ()
+	{
+		return Exp::make(eVar, std::string("a"), {}, span);
+	};
+
+	auto exp_cmp = Exp::make(eiTag, ctorname, tag, { util_var() }, span);
 
 	proto.funcs.push_back({
 		true,
@@ -91,7 +113,8 @@ static void generateCtor (GlobProto& proto,
 			throw sig->span.die(ss.str());
 		}
 
-		auto exp_get = Exp::make(eiGet, int_t(i), { util_var }, span);
+		auto exp_get = Exp::make(eiGet, CtorField { int_t(i), tag },
+			{ util_var() }, span);
 		exp_get->setType(sig->args[i].second);
 		exp_get->setString(ctorname); // ju_safe_get  instead of  ju_get
 
@@ -121,7 +144,9 @@ void GlobEnv::generateType (TypeDecl& tydecl)
 		for (size_t j = 0; j < i; j++)
 			if (tydecl.ctors[j].name == ctor.name)
 				throw span.die("constructors must have distinct names");
-		i++;
+
+		auto tag = int_t(i++);
+		ctorTags[{ tydecl.name, ctor.name }] = tag;
 
 		for (auto& arg : ctor.signature->args)
 			sig->args.push_back({
@@ -129,6 +154,6 @@ void GlobEnv::generateType (TypeDecl& tydecl)
 				fillTypes(arg.second, tydecl.polytypes, span)
 			});
 
-		generateCtor(proto, fields, mainty, ctor.name, sig, span);
+		generateCtor(proto, fields, mainty, ctor.name, tag, sig, span);
 	}
 }
\ No newline at end of file
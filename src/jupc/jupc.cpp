@@ -273,8 +273,10 @@ static bool compileLLVM (Result& data, const std::string& outFile)
 
 static bool compileAsm (Result& data, const std::string& inFile, const std::string& outFile)
 {
+	// calls the compiler marks 'tail' are only guaranteed
+	//  to not grow the stack with -tailcallopt
 	std::ostringstream ss;
-	ss << "llc -o " << escape(outFile) << " "
+	ss << "llc -tailcallopt -o " << escape(outFile) << " "
 	   << escape(inFile);
 
 	return shell_exec(ss.str()) == 0;
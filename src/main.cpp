@@ -23,6 +23,11 @@ static int Main (std::vector<std::string> args)
 		Lexer::generateKeyMaps();
 		return 0;
 	}
+	if (args.size() > 1 && args[1] == "-benchlex")
+	{
+		Lexer::benchmark(args.size() > 2 ? std::stoul(args[2]) : 8);
+		return 0;
+	}
 
 	if (args.size() <= 1)
 	{